@@ -0,0 +1,339 @@
+/**
+ * @file BlockIo.cpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Positioned file I/O with several requests in flight.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "BlockIo.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef PASS_RENDER_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+bool BlockIo::uring_allowed = true;
+
+/** One pread() or pwrite(); -errno on failure. */
+static int64_t transfer(int fd, bool write, void* data, size_t bytes,
+                        int64_t offset) {
+#ifdef _WIN32
+  // Each descriptor is used by a single thread, so seeking first is safe.
+  if (_lseeki64(fd, offset, SEEK_SET) < 0) return -errno;
+  int n = write ? _write(fd, data, (unsigned)bytes)
+                : _read(fd, data, (unsigned)bytes);
+#else
+  ssize_t n = write ? pwrite(fd, data, bytes, offset)
+                    : pread(fd, data, bytes, offset);
+#endif
+  return n < 0 ? -errno : (int64_t)n;
+}
+
+#ifdef PASS_RENDER_IO_URING
+
+/**
+ * A raw io_uring, driven through the system calls so that no liburing is
+ * needed. This thread is the only producer of submissions and the only
+ * consumer of completions; the kernel is the other side of both rings.
+ */
+struct BlockIo::Uring {
+  int fd = -1;
+  bool fixed = false;
+  unsigned queued = 0;
+
+  void* sq_map = MAP_FAILED;
+  size_t sq_map_bytes = 0;
+  void* cq_map = MAP_FAILED;
+  size_t cq_map_bytes = 0;
+  void* sqes_map = MAP_FAILED;
+  size_t sqes_map_bytes = 0;
+
+  unsigned* sq_tail = nullptr;
+  unsigned* sq_mask = nullptr;
+  unsigned* sq_array = nullptr;
+  io_uring_sqe* sqes = nullptr;
+  unsigned* cq_head = nullptr;
+  unsigned* cq_tail = nullptr;
+  unsigned* cq_mask = nullptr;
+  io_uring_cqe* cqes = nullptr;
+
+  ~Uring() {
+    if (sqes_map != MAP_FAILED) munmap(sqes_map, sqes_map_bytes);
+    if (cq_map != MAP_FAILED && cq_map != sq_map) {
+      munmap(cq_map, cq_map_bytes);
+    }
+    if (sq_map != MAP_FAILED) munmap(sq_map, sq_map_bytes);
+    if (fd >= 0) close(fd);
+  }
+
+  bool setup(unsigned entries, char* buffers, size_t buffer_bytes) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) return false;
+
+    sq_map_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_map_bytes =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+      sq_map_bytes = cq_map_bytes = std::max(sq_map_bytes, cq_map_bytes);
+    }
+    sq_map = mmap(nullptr, sq_map_bytes, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sq_map == MAP_FAILED) return false;
+    cq_map = single ? sq_map
+                    : mmap(nullptr, cq_map_bytes, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    if (cq_map == MAP_FAILED) return false;
+    sqes_map_bytes = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_map = mmap(nullptr, sqes_map_bytes, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes_map == MAP_FAILED) return false;
+
+    char* sq = (char*)sq_map;
+    sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    sq_array = (unsigned*)(sq + params.sq_off.array);
+    sqes = (io_uring_sqe*)sqes_map;
+    char* cq = (char*)cq_map;
+    cq_head = (unsigned*)(cq + params.cq_off.head);
+    cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+
+    // Registered buffers spare the kernel mapping the pages on every
+    // request. They count against RLIMIT_MEMLOCK; without them the plain
+    // READ and WRITE opcodes do the same work.
+    std::vector<iovec> iovecs(entries);
+    for (unsigned i = 0; i < entries; ++i) {
+      iovecs[i].iov_base = buffers + i * buffer_bytes;
+      iovecs[i].iov_len = buffer_bytes;
+    }
+    fixed = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                    iovecs.data(), entries) == 0;
+    return true;
+  }
+
+  void push(int slot, bool write, int target, char* data, size_t bytes,
+            int64_t offset) {
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    if (fixed) {
+      sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+      sqe->buf_index = (uint16_t)slot;
+    } else {
+      sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    }
+    sqe->fd = target;
+    sqe->off = (uint64_t)offset;
+    sqe->addr = (uint64_t)(uintptr_t)data;
+    sqe->len = (uint32_t)bytes;
+    sqe->user_data = (uint64_t)slot;
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++queued;
+  }
+
+  /** Submits what is queued and waits for `wait` completions. */
+  int enter(unsigned wait) {
+    while (true) {
+      long n = syscall(__NR_io_uring_enter, fd, queued, wait,
+                       wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+      if (n >= 0) {
+        queued -= (unsigned)n;
+        return 0;
+      }
+      if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return -errno;
+    }
+  }
+
+  bool reap(int* slot, int64_t* result) {
+    unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return false;
+    const io_uring_cqe* cqe = &cqes[head & *cq_mask];
+    *slot = (int)cqe->user_data;
+    *result = cqe->res;
+    __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+};
+
+#else
+
+// Never constructed; keeps the members below compiling without the ring.
+struct BlockIo::Uring {
+  void push(int, bool, int, char*, size_t, int64_t) {}
+  int enter(unsigned) { return 0; }
+  bool reap(int*, int64_t*) { return false; }
+};
+
+#endif
+
+BlockIo::~BlockIo() {
+  // Buffers must outlive every request the kernel may still be filling.
+  int64_t result;
+  while (complete(&result) >= 0) {
+  }
+  delete ring;
+}
+
+void BlockIo::init(int depth, size_t buffer_bytes) {
+  this->buffer_bytes = buffer_bytes;
+  buffers.assign(depth * buffer_bytes, 0);
+  requests.assign(depth, Request());
+#ifdef PASS_RENDER_IO_URING
+  if (uring_allowed) {
+    ring = new Uring();
+    if (!ring->setup(depth, buffers.data(), buffer_bytes)) {
+      delete ring;
+      ring = nullptr;
+    }
+  }
+#endif
+}
+
+void BlockIo::queueRead(int fd, int slot, int64_t offset, size_t bytes) {
+  queue(fd, slot, false, offset, bytes);
+}
+
+void BlockIo::queueWrite(int fd, int slot, int64_t offset, size_t bytes) {
+  queue(fd, slot, true, offset, bytes);
+}
+
+void BlockIo::queue(int fd, int slot, bool write, int64_t offset,
+                    size_t bytes) {
+  Request& request = requests[slot];
+  request.fd = fd;
+  request.write = write;
+  request.offset = offset;
+  request.bytes = bytes;
+  request.done = 0;
+  ++in_flight;
+  resume(slot);
+}
+
+void BlockIo::submit() {
+  if (ring) ring->enter(0);
+}
+
+void BlockIo::resume(int slot) {
+  Request& request = requests[slot];
+  if (!ring) {
+    finished.push_back(std::make_pair(slot, transferNow(slot)));
+    return;
+  }
+  ring->push(slot, request.write, request.fd, buffer(slot) + request.done,
+             request.bytes - request.done, request.offset + request.done);
+}
+
+int64_t BlockIo::transferNow(int slot) {
+  Request& request = requests[slot];
+  return transfer(request.fd, request.write, buffer(slot) + request.done,
+                  request.bytes - request.done,
+                  request.offset + request.done);
+}
+
+int BlockIo::complete(int64_t* result) {
+  while (in_flight > 0) {
+    int slot = -1;
+    int64_t n = 0;
+    if (!ring) {
+      slot = finished.front().first;
+      n = finished.front().second;
+      finished.pop_front();
+    } else if (!ring->reap(&slot, &n)) {
+      int error = ring->enter(1);
+      if (error < 0) {
+        // The ring is unusable; nothing more will complete.
+        in_flight = 0;
+        *result = error;
+        return -1;
+      }
+      continue;
+    }
+
+    // Short transfers are continued until the request is done or the file
+    // ends.
+    Request& request = requests[slot];
+    if (n == -EINTR || n == -EAGAIN) {
+      resume(slot);
+      continue;
+    }
+    if (n > 0) {
+      request.done += (size_t)n;
+      if (request.done < request.bytes) {
+        resume(slot);
+        continue;
+      }
+    }
+    --in_flight;
+    *result = n < 0 ? n : (int64_t)request.done;
+    return slot;
+  }
+  return -1;
+}
+
+int BlockIo::openFile(const std::string& path, bool write, bool truncate) {
+  int flags = write ? O_WRONLY : O_RDONLY;
+  if (truncate) flags |= O_CREAT | O_TRUNC;
+#ifdef _WIN32
+  return _open(path.c_str(), flags | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+  return open(path.c_str(), flags | O_CLOEXEC, 0666);
+#endif
+}
+
+bool BlockIo::closeFile(int fd) {
+#ifdef _WIN32
+  return _close(fd) == 0;
+#else
+  return close(fd) == 0;
+#endif
+}
+
+int64_t BlockIo::readAt(int fd, void* data, size_t bytes, int64_t offset) {
+  size_t done = 0;
+  while (done < bytes) {
+    int64_t n = transfer(fd, false, (char*)data + done, bytes - done,
+                         offset + done);
+    if (n == -EINTR) continue;
+    if (n < 0) return n;
+    if (n == 0) break;
+    done += (size_t)n;
+  }
+  return (int64_t)done;
+}
+
+bool BlockIo::writeAt(int fd, const void* data, size_t bytes,
+                      int64_t offset) {
+  size_t done = 0;
+  while (done < bytes) {
+    int64_t n = transfer(fd, true, (char*)data + done, bytes - done,
+                         offset + done);
+    if (n == -EINTR) continue;
+    if (n <= 0) return false;
+    done += (size_t)n;
+  }
+  return true;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file BlockIo.hpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Positioned file I/O with several requests in flight.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+/**
+ * Reads and writes of a fixed set of buffers at explicit file offsets, with
+ * up to depth() of them in flight. Builds with PASS_RENDER_IO_URING send the
+ * requests through an io_uring with the buffers registered up front. Other
+ * builds, and kernels that refuse a ring, do each request on the spot with
+ * pread() or pwrite(), so it has completed by the time submit returns.
+ *
+ * Requests complete in any order. A BlockIo belongs to one thread.
+ */
+struct BlockIo {
+  // Process-wide switch; false forces the pread()/pwrite() path.
+  static bool uring_allowed;
+
+  BlockIo() {}
+  BlockIo(const BlockIo&) = delete;
+  BlockIo& operator=(const BlockIo&) = delete;
+  ~BlockIo();
+
+  /** Allocates `depth` buffers of `buffer_bytes` each. */
+  void init(int depth, size_t buffer_bytes);
+  bool ready() const { return !buffers.empty(); }
+  bool usingUring() const { return ring != nullptr; }
+  int depth() const { return (int)requests.size(); }
+  int pending() const { return in_flight; }
+  char* buffer(int slot) { return &buffers[slot * buffer_bytes]; }
+
+  // Queued requests start at the latest on the next submit() or complete().
+  void queueRead(int fd, int slot, int64_t offset, size_t bytes);
+  void queueWrite(int fd, int slot, int64_t offset, size_t bytes);
+  void submit();
+
+  /**
+   * Waits for a request to finish and returns its slot. `result` receives
+   * the bytes transferred, short only at end of file, or -errno. Returns -1
+   * if nothing is in flight.
+   */
+  int complete(int64_t* result);
+
+  // Synchronous helpers for headers, on the same descriptors.
+  static int openFile(const std::string& path, bool write, bool truncate);
+  static bool closeFile(int fd);
+  static int64_t readAt(int fd, void* data, size_t bytes, int64_t offset);
+  static bool writeAt(int fd, const void* data, size_t bytes,
+                      int64_t offset);
+
+ private:
+  struct Request {
+    int fd = -1;
+    bool write = false;
+    int64_t offset = 0;
+    size_t bytes = 0;
+    size_t done = 0;
+  };
+  struct Uring;
+
+  std::vector<char> buffers;
+  size_t buffer_bytes = 0;
+  std::vector<Request> requests;
+  int in_flight = 0;
+  Uring* ring = nullptr;
+  // Completions of the synchronous path, as (slot, result).
+  std::deque<std::pair<int, int64_t>> finished;
+
+  void queue(int fd, int slot, bool write, int64_t offset, size_t bytes);
+  void resume(int slot);
+  int64_t transferNow(int slot);
+};
@@ -0,0 +1,24 @@
+/**
+ * @file BusEngine.hpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief The SUM/AVG core of PassEngine.hpp on Rack's float_4, shared by the
+ * modules.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+#include "PassEngine.hpp"
+#include "plugin.hpp"
+
+template <>
+struct SampleLanes<simd::float_4> {
+  static const int value = 4;
+  typedef float scalar;
+};
+
+// The SUM/AVG core shared with pass_render, one row per float_4 block.
+typedef TPassEngine<simd::float_4> BusEngine;
@@ -0,0 +1,149 @@
+/**
+ * @file BusRecorder.cpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Records the Pass bus to FLAC on a background thread.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "BusRecorder.hpp"
+
+#include <chrono>
+#include <memory>
+
+#include "Flac.hpp"
+#include "Wav.hpp"
+
+using simd::float_4;
+
+// How often the encoder looks for a full block.
+static const std::chrono::milliseconds ENCODER_POLL(20);
+
+/** `path` with `suffix` inserted before its extension, if it has one. */
+static std::string withSuffix(const std::string& path,
+                              const std::string& suffix) {
+  size_t dot = path.find_last_of('.');
+  size_t slash = path.find_last_of("/\\");
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+    return path + suffix;
+  }
+  return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+void BusRecorder::start(const std::string& path, int sample_rate) {
+  stop();
+  // Allocated once and never freed while the module lives, so a push racing
+  // a stop can never write to released memory.
+  if (ring.empty()) {
+    ring.assign(RING_FLOATS, 0.f);
+  }
+  this->path = path;
+  dropped = 0;
+  clipped = 0;
+  failed = false;
+  channels = 0;
+  head.store(tail.load());
+  running.store(true, std::memory_order_release);
+  encoder = std::thread(&BusRecorder::encode, this, path, sample_rate);
+}
+
+void BusRecorder::stop() {
+  running.store(false, std::memory_order_release);
+  if (encoder.joinable()) {
+    encoder.join();
+  }
+}
+
+void BusRecorder::push(const float_4* frame, int frame_channels) {
+  int count = channels.load(std::memory_order_relaxed);
+  if (count == 0) {
+    if (frame_channels == 0) return;
+    count = frame_channels;
+    channels.store(count, std::memory_order_release);
+  }
+
+  size_t t = tail.load(std::memory_order_relaxed);
+  if (t - head.load(std::memory_order_acquire) + count > ring.size()) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  // Channels the bus no longer carries are recorded as silence.
+  size_t mask = ring.size() - 1;
+  for (int c = 0; c < count; ++c) {
+    ring[(t + c) & mask] = c < frame_channels ? frame[c / 4][c % 4] : 0.f;
+  }
+  tail.store(t + count, std::memory_order_release);
+}
+
+void BusRecorder::encode(std::string path, int sample_rate) {
+  while (running.load(std::memory_order_acquire) &&
+         channels.load(std::memory_order_acquire) == 0) {
+    std::this_thread::sleep_for(ENCODER_POLL);
+  }
+  int count = channels.load(std::memory_order_acquire);
+  if (count == 0) return;
+
+  const int group = FlacWriter::MAX_CHANNELS;
+  int files = (count + group - 1) / group;
+  std::unique_ptr<FlacWriter[]> writers(new FlacWriter[files]);
+  for (int f = 0; f < files; ++f) {
+    int first = f * group;
+    int width = std::min(group, count - first);
+    std::string file_path = path;
+    if (f > 0) {
+      file_path =
+          withSuffix(path, string::f("-%d-%d", first + 1, first + width));
+    }
+    if (!writers[f].open(file_path, width, sample_rate)) {
+      failed = true;
+      running = false;
+      return;
+    }
+  }
+
+  const int block = FlacWriter::BLOCK_SIZE;
+  size_t mask = ring.size() - 1;
+  std::vector<int32_t> pcm((size_t)block * group);
+  const float full_scale = (float)(1 << (FlacWriter::BITS - 1));
+  const float scale = full_scale / WAV_VOLTS;
+  while (true) {
+    bool stopping = !running.load(std::memory_order_acquire);
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t frames = (tail.load(std::memory_order_acquire) - h) / count;
+    // Only full blocks until the recording stops, then the remainder.
+    if (frames < (size_t)block && !stopping) {
+      std::this_thread::sleep_for(ENCODER_POLL);
+      continue;
+    }
+    if (frames == 0) break;
+    frames = std::min(frames, (size_t)block);
+
+    int64_t block_clipped = 0;
+    for (int f = 0; f < files; ++f) {
+      int first = f * group;
+      int width = std::min(group, count - first);
+      for (size_t i = 0; i < frames; ++i) {
+        for (int c = 0; c < width; ++c) {
+          float v = ring[(h + i * count + first + c) & mask] * scale;
+          if (v < -full_scale || v > full_scale - 1.f) {
+            v = clamp(v, -full_scale, full_scale - 1.f);
+            ++block_clipped;
+          }
+          pcm[i * width + c] = (int32_t)std::lrint(v);
+        }
+      }
+      if (!writers[f].write(pcm.data(), (int)frames)) failed = true;
+    }
+    if (block_clipped > 0) {
+      clipped.fetch_add(block_clipped, std::memory_order_relaxed);
+    }
+    head.store(h + frames * count, std::memory_order_release);
+  }
+
+  for (int f = 0; f < files; ++f) {
+    if (!writers[f].close()) failed = true;
+  }
+}
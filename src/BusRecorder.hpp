@@ -0,0 +1,66 @@
+/**
+ * @file BusRecorder.hpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Records the Pass bus to FLAC on a background thread.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "plugin.hpp"
+
+/**
+ * Streams the bus to 24 bit FLAC. The audio thread only copies each frame
+ * into a lock-free ring; an encoder thread takes the frames off in blocks of
+ * FlacWriter::BLOCK_SIZE, converts and compresses them and writes the file.
+ *
+ * The channel count is fixed by the first frame with any channels. Buses
+ * wider than FLAC's 8 channels are split across files: channels 9 to 16 go
+ * to a second file named after the first with "-9-16" before the extension.
+ *
+ * Full scale is WAV_VOLTS, with the same 2^23 steps per WAV_VOLTS as
+ * pass_render's 24 bit output. Louder samples are clipped and counted.
+ *
+ * If the encoder falls more than RING_FLOATS samples behind, new frames are
+ * dropped and counted rather than blocking the audio thread.
+ */
+struct BusRecorder {
+  static const int RING_FLOATS = 1 << 21;
+
+  ~BusRecorder() { stop(); }
+
+  /** Starts recording to `path`; UI thread only. */
+  void start(const std::string& path, int sample_rate);
+
+  /** Finishes the files; UI thread only. */
+  void stop();
+
+  bool active() const { return running.load(std::memory_order_relaxed); }
+
+  /** Queues one frame of `channels` bus channels; audio thread only. */
+  void push(const simd::float_4* frame, int channels);
+
+  std::string path;
+  std::atomic<int64_t> dropped{0};
+  std::atomic<int64_t> clipped{0};
+  std::atomic<bool> failed{false};
+
+ private:
+  std::vector<float> ring;
+  // Monotonic sample counts; only their difference wraps around the ring.
+  std::atomic<size_t> head{0};
+  std::atomic<size_t> tail{0};
+  std::atomic<int> channels{0};
+  std::atomic<bool> running{false};
+  std::thread encoder;
+
+  void encode(std::string path, int sample_rate);
+};
@@ -0,0 +1,192 @@
+/**
+ * @file Convolver.cpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Uniformly partitioned FFT convolution for the Pass bus.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "Convolver.hpp"
+
+#include <cstring>
+
+#include "Resampler.hpp"
+#include "Wav.hpp"
+
+using simd::float_4;
+
+// Spectra of FFT_SIZE real samples, stored as float_4.
+static const int SPECTRUM_VECTORS = Convolver::FFT_SIZE / 4;
+
+Convolver::Convolver(const float* ir, int length) : fft(FFT_SIZE) {
+  length = std::min(length, MAX_FRAMES);
+  partitions = (length + BLOCK - 1) / BLOCK;
+
+  ir_spectra.resize(partitions * SPECTRUM_VECTORS, 0.f);
+  delay_line.resize(MAX_CHANNELS * partitions * SPECTRUM_VECTORS, 0.f);
+  input.resize(MAX_CHANNELS / 4 * FFT_SIZE, 0.f);
+  output.resize(MAX_CHANNELS / 4 * BLOCK, 0.f);
+  spectrum.resize(SPECTRUM_VECTORS, 0.f);
+  scratch.resize(SPECTRUM_VECTORS, 0.f);
+  tail.resize(MAX_CHANNELS * SPECTRUM_VECTORS, 0.f);
+
+  // Unit energy keeps the level of broadband material about the same
+  // whichever IR is loaded.
+  float energy = 0.f;
+  for (int i = 0; i < length; ++i) {
+    energy += ir[i] * ir[i];
+  }
+  float gain = energy > 0.f ? 1.f / std::sqrt(energy) : 0.f;
+
+  float* time = (float*)scratch.data();
+  for (int p = 0; p < partitions; ++p) {
+    std::fill(time, time + FFT_SIZE, 0.f);
+    int frames = std::min(BLOCK, length - p * BLOCK);
+    for (int i = 0; i < frames; ++i) {
+      time[i] = ir[p * BLOCK + i] * gain;
+    }
+    fft.rfftUnordered(time, irSpectrum(p));
+  }
+}
+
+Convolver* Convolver::load(const std::string& path, float sample_rate,
+                           std::string* error) {
+  WavReader reader;
+  if (!reader.open(path, error)) return nullptr;
+  const WavInfo& info = reader.info;
+
+  int rate = (int)std::round(sample_rate);
+  int64_t frames = info.frames;
+  Resampler resampler;
+  bool resampled = info.sample_rate != rate;
+  if (resampled) {
+    if (!resampler.init(info.sample_rate, rate, info.channels)) {
+      *error = path + ": invalid sample rate";
+      return nullptr;
+    }
+    frames = resampler.outputFrames(frames);
+  }
+  frames = std::min<int64_t>(frames, MAX_FRAMES);
+  if (frames == 0) {
+    *error = path + ": no audio";
+    return nullptr;
+  }
+
+  // All channels are decoded, only the first is used.
+  std::vector<float> planes(info.channels * frames, 0.f);
+  if (resampled) {
+    resampler.process(&reader, planes.data(), (int)frames, (int)frames);
+  } else {
+    reader.read(planes.data(), (int)frames, (int)frames);
+  }
+  if (reader.ioError()) {
+    *error = path + ": " + std::strerror(-reader.ioError());
+    return nullptr;
+  }
+  return new Convolver(planes.data(), (int)frames);
+}
+
+float* Convolver::irSpectrum(int p) {
+  return (float*)&ir_spectra[p * SPECTRUM_VECTORS];
+}
+
+float* Convolver::delaySpectrum(int c, int slot) {
+  return (float*)&delay_line[(c * partitions + slot) * SPECTRUM_VECTORS];
+}
+
+float* Convolver::tailSpectrum(int c) {
+  return (float*)&tail[c * SPECTRUM_VECTORS];
+}
+
+void Convolver::process(float_4* frame, int channels) {
+  // Channels that appear on the bus start from silence rather than from
+  // whatever they held when they were last active.
+  for (int c = active_channels; c < channels; ++c) {
+    std::fill(delay_line.begin() + c * partitions * SPECTRUM_VECTORS,
+              delay_line.begin() + (c + 1) * partitions * SPECTRUM_VECTORS,
+              0.f);
+    std::fill(tail.begin() + c * SPECTRUM_VECTORS,
+              tail.begin() + (c + 1) * SPECTRUM_VECTORS, 0.f);
+    for (int t = 0; t < FFT_SIZE; ++t) {
+      input[c / 4 * FFT_SIZE + t][c % 4] = 0.f;
+    }
+    for (int t = 0; t < BLOCK; ++t) {
+      output[c / 4 * BLOCK + t][c % 4] = 0.f;
+    }
+  }
+  active_channels = channels;
+
+  // Time domain buffers keep four channels per float_4, like the bus.
+  for (int c = 0; c < channels; c += 4) {
+    input[c / 4 * FFT_SIZE + BLOCK + pos] = frame[c / 4];
+    frame[c / 4] = output[c / 4 * BLOCK + pos];
+  }
+
+  // This frame's slice of the products the next block needs.
+  int units = block_channels * (partitions - 1);
+  accumulateTail(pos * units / BLOCK, (pos + 1) * units / BLOCK);
+
+  if (++pos == BLOCK) {
+    pos = 0;
+    processBlock(channels);
+  }
+}
+
+/**
+ * Accumulates work units [first, last) of the current block into the tail
+ * sums. Unit u is partition 1 + u % (partitions - 1) of channel
+ * u / (partitions - 1).
+ */
+void Convolver::accumulateTail(int first, int last) {
+  float scale = 1.f / FFT_SIZE;
+  int tail_partitions = partitions - 1;
+  for (int u = first; u < last; ++u) {
+    int c = u / tail_partitions;
+    int p = 1 + u % tail_partitions;
+    // After the next boundary moves head back by one, slot head + p - 1
+    // holds the input from p blocks before that block.
+    int slot = head + p - 1;
+    if (slot >= partitions) slot -= partitions;
+    pffft_zconvolve_accumulate(fft.setup, delaySpectrum(c, slot),
+                               irSpectrum(p), tailSpectrum(c), scale);
+  }
+}
+
+void Convolver::processBlock(int channels) {
+  head = head == 0 ? partitions - 1 : head - 1;
+  float scale = 1.f / FFT_SIZE;
+  float* time = (float*)scratch.data();
+  float* sum = (float*)spectrum.data();
+
+  for (int c = 0; c < channels; ++c) {
+    float_4* window = &input[c / 4 * FFT_SIZE];
+    for (int t = 0; t < FFT_SIZE; ++t) {
+      time[t] = window[t][c % 4];
+    }
+    fft.rfftUnordered(time, delaySpectrum(c, head));
+
+    // The newest block meets IR partition 0; the older ones were summed
+    // into the tail during the last block.
+    std::copy(tailSpectrum(c), tailSpectrum(c) + FFT_SIZE, sum);
+    pffft_zconvolve_accumulate(fft.setup, delaySpectrum(c, head),
+                               irSpectrum(0), sum, scale);
+    fft.irfftUnordered(sum, time);
+
+    // Overlap-save: only the second half is free of circular wrap-around.
+    float_4* block = &output[c / 4 * BLOCK];
+    for (int t = 0; t < BLOCK; ++t) {
+      block[t][c % 4] = time[BLOCK + t];
+    }
+  }
+
+  for (int c = 0; c < channels; c += 4) {
+    float_4* window = &input[c / 4 * FFT_SIZE];
+    std::copy(window + BLOCK, window + FFT_SIZE, window);
+  }
+
+  std::fill(tail.begin(), tail.end(), 0.f);
+  block_channels = channels;
+}
@@ -0,0 +1,341 @@
+/**
+ * @file Flac.cpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Minimal FLAC encoder for bus recordings.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "Flac.hpp"
+
+#include <algorithm>
+
+static const int MAX_ORDER = 4;
+static const int MAX_PARTITION_ORDER = 6;
+static const int MAX_RICE_PARAM = 30;
+static const int STREAMINFO_BYTES = 34;
+
+/**
+ * Appends big-endian bit fields to a byte vector.
+ */
+struct BitWriter {
+  std::vector<uint8_t>* out;
+  uint64_t bits = 0;
+  int count = 0;
+
+  explicit BitWriter(std::vector<uint8_t>* out) : out(out) {}
+
+  void put(uint32_t value, int width) {
+    uint64_t mask = width == 32 ? 0xffffffffu : (1u << width) - 1;
+    bits = (bits << width) | (value & mask);
+    count += width;
+    while (count >= 8) {
+      count -= 8;
+      out->push_back((uint8_t)(bits >> count));
+    }
+  }
+
+  void unary(uint32_t zeros) {
+    for (; zeros >= 32; zeros -= 32) {
+      put(0, 32);
+    }
+    put(1, zeros + 1);
+  }
+
+  void align() {
+    if (count > 0) put(0, 8 - count);
+  }
+};
+
+static uint8_t crc8(const uint8_t* data, size_t size) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < size; ++i) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; ++b) {
+      crc = crc & 0x80 ? (uint8_t)(crc << 1 ^ 0x07) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+struct Crc16Table {
+  uint16_t entries[256];
+
+  Crc16Table() {
+    for (int i = 0; i < 256; ++i) {
+      uint16_t crc = (uint16_t)(i << 8);
+      for (int b = 0; b < 8; ++b) {
+        crc = crc & 0x8000 ? (uint16_t)(crc << 1 ^ 0x8005)
+                           : (uint16_t)(crc << 1);
+      }
+      entries[i] = crc;
+    }
+  }
+};
+
+static uint16_t crc16(const uint8_t* data, size_t size) {
+  // Built once, thread-safely, by the first encoder that needs it.
+  static const Crc16Table table;
+  uint16_t crc = 0;
+  for (size_t i = 0; i < size; ++i) {
+    crc = (uint16_t)(crc << 8 ^ table.entries[(crc >> 8) ^ data[i]]);
+  }
+  return crc;
+}
+
+/** Frame header code of the common sample rates; 0 refers to STREAMINFO. */
+static int rateCode(int sample_rate) {
+  static const int RATES[][2] = {
+      {88200, 1}, {176400, 2}, {192000, 3}, {8000, 4},   {16000, 5},
+      {22050, 6}, {24000, 7},  {32000, 8},  {44100, 9},  {48000, 10},
+      {96000, 11}};
+  for (const auto& rate : RATES) {
+    if (rate[0] == sample_rate) return rate[1];
+  }
+  return 0;
+}
+
+/** The frame number in FLAC's extended UTF-8 coding. */
+static void putFrameNumber(BitWriter& writer, uint32_t n) {
+  if (n < 0x80) {
+    writer.put(n, 8);
+    return;
+  }
+  int extra = n < 0x800 ? 1 : n < 0x10000 ? 2 : n < 0x200000 ? 3
+                                                : n < 0x4000000 ? 4 : 5;
+  uint32_t lead = (0xff00u >> (extra + 1)) & 0xff;
+  writer.put(lead | n >> (6 * extra), 8);
+  for (int i = extra - 1; i >= 0; --i) {
+    writer.put(0x80 | ((n >> (6 * i)) & 0x3f), 8);
+  }
+}
+
+/** Zigzag folding of a signed residual for Rice coding. */
+static uint32_t fold(int32_t residual) {
+  return (uint32_t)residual << 1 ^ (uint32_t)(residual >> 31);
+}
+
+static void predict(const int32_t* x, int n, int order, int32_t* residual) {
+  for (int i = order; i < n; ++i) {
+    switch (order) {
+      case 0:
+        residual[i] = x[i];
+        break;
+      case 1:
+        residual[i] = x[i] - x[i - 1];
+        break;
+      case 2:
+        residual[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+        break;
+      case 3:
+        residual[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+        break;
+      default:
+        residual[i] =
+            x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+        break;
+    }
+  }
+}
+
+/**
+ * Rice parameter and estimated bits of a partition of `count` folded
+ * residuals summing to `sum`. Sum >> k stands in for the exact unary length.
+ */
+static int riceParam(uint64_t sum, int count, uint64_t* bits) {
+  int k = 0;
+  while (k < MAX_RICE_PARAM && ((uint64_t)count << (k + 1)) < sum) {
+    ++k;
+  }
+  *bits = (uint64_t)count * (k + 1) + (sum >> k);
+  return k;
+}
+
+FlacWriter::~FlacWriter() { close(); }
+
+bool FlacWriter::open(const std::string& path, int channels,
+                      int sample_rate) {
+  close();
+  file = std::fopen(path.c_str(), "wb");
+  if (!file) return false;
+  this->channels = channels;
+  this->sample_rate = sample_rate;
+  total_frames = 0;
+  frame_number = 0;
+  min_frame_bytes = 0;
+  max_frame_bytes = 0;
+  failed = false;
+  channel.resize(BLOCK_SIZE);
+  residual.resize(BLOCK_SIZE);
+  folded.resize(BLOCK_SIZE);
+
+  // The stream info is final only on close(), which rewrites it in place.
+  const uint8_t header[8] = {'f', 'L', 'a', 'C', 0x80, 0, 0,
+                             STREAMINFO_BYTES};
+  failed = std::fwrite(header, 1, 8, file) != 8;
+  return writeStreamInfo() && !failed;
+}
+
+bool FlacWriter::writeStreamInfo() {
+  bytes.clear();
+  BitWriter writer(&bytes);
+  writer.put(BLOCK_SIZE, 16);
+  writer.put(BLOCK_SIZE, 16);
+  writer.put(min_frame_bytes, 24);
+  writer.put(max_frame_bytes, 24);
+  writer.put(sample_rate, 20);
+  writer.put(channels - 1, 3);
+  writer.put(BITS - 1, 5);
+  writer.put((uint32_t)(total_frames >> 32), 4);
+  writer.put((uint32_t)total_frames, 32);
+  for (int i = 0; i < 4; ++i) {
+    writer.put(0, 32);
+  }
+  return std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+}
+
+bool FlacWriter::write(const int32_t* samples, int frames) {
+  if (!file || frames <= 0) return false;
+  bytes.clear();
+  BitWriter writer(&bytes);
+
+  // Frame header: sync code, fixed block size, then the block size, rate,
+  // channel layout and sample size codes. A short block states its size
+  // after the frame number.
+  writer.put(0x3ffe, 14);
+  writer.put(0, 2);
+  writer.put(frames == BLOCK_SIZE ? 12 : 7, 4);
+  writer.put(rateCode(sample_rate), 4);
+  writer.put(channels - 1, 4);
+  writer.put(6, 3);
+  writer.put(0, 1);
+  putFrameNumber(writer, frame_number);
+  if (frames != BLOCK_SIZE) {
+    writer.put(frames - 1, 16);
+  }
+  writer.put(crc8(bytes.data(), bytes.size()), 8);
+
+  for (int c = 0; c < channels; ++c) {
+    for (int i = 0; i < frames; ++i) {
+      channel[i] = samples[i * channels + c];
+    }
+
+    bool constant = true;
+    for (int i = 1; i < frames && constant; ++i) {
+      constant = channel[i] == channel[0];
+    }
+    if (constant) {
+      writer.put(0, 8);
+      writer.put(channel[0], BITS);
+      continue;
+    }
+
+    // The order whose residual has the smallest magnitude usually codes
+    // smallest too.
+    int order = 0;
+    uint64_t best_sum = UINT64_MAX;
+    for (int o = 0; o <= std::min(MAX_ORDER, frames - 1); ++o) {
+      predict(channel.data(), frames, o, residual.data());
+      uint64_t sum = 0;
+      for (int i = o; i < frames; ++i) {
+        sum += fold(residual[i]);
+      }
+      if (sum < best_sum) {
+        best_sum = sum;
+        order = o;
+      }
+    }
+    predict(channel.data(), frames, order, residual.data());
+    for (int i = order; i < frames; ++i) {
+      folded[i] = fold(residual[i]);
+    }
+
+    // Finest partitioning first; coarser orders merge its sums pairwise.
+    int max_partition = 0;
+    while (max_partition < MAX_PARTITION_ORDER &&
+           frames % (2 << max_partition) == 0 &&
+           (frames >> (max_partition + 1)) > order) {
+      ++max_partition;
+    }
+    uint64_t sums[1 << MAX_PARTITION_ORDER];
+    int parts = 1 << max_partition;
+    int size = frames >> max_partition;
+    for (int p = 0; p < parts; ++p) {
+      sums[p] = 0;
+      for (int i = std::max(p * size, order); i < (p + 1) * size; ++i) {
+        sums[p] += folded[i];
+      }
+    }
+
+    int best_partition = 0;
+    uint64_t best_bits = UINT64_MAX;
+    int params[1 << MAX_PARTITION_ORDER];
+    int best_params[1 << MAX_PARTITION_ORDER];
+    for (int po = max_partition; po >= 0; --po) {
+      int count = 1 << po;
+      int span = frames >> po;
+      uint64_t bits = 0;
+      for (int p = 0; p < count; ++p) {
+        uint64_t part_bits;
+        int samples_in = span - (p == 0 ? order : 0);
+        params[p] = riceParam(sums[p], samples_in, &part_bits);
+        bits += 5 + part_bits;
+      }
+      if (bits < best_bits) {
+        best_bits = bits;
+        best_partition = po;
+        std::copy(params, params + count, best_params);
+      }
+      for (int p = 0; p < count / 2; ++p) {
+        sums[p] = sums[2 * p] + sums[2 * p + 1];
+      }
+    }
+
+    if (order * BITS + 6 + best_bits >= (uint64_t)frames * BITS) {
+      writer.put(2, 8);
+      for (int i = 0; i < frames; ++i) {
+        writer.put(channel[i], BITS);
+      }
+      continue;
+    }
+
+    writer.put(0x10 | order << 1, 8);
+    for (int i = 0; i < order; ++i) {
+      writer.put(channel[i], BITS);
+    }
+    writer.put(1, 2);
+    writer.put(best_partition, 4);
+    int span = frames >> best_partition;
+    for (int p = 0; p < (1 << best_partition); ++p) {
+      int k = best_params[p];
+      writer.put(k, 5);
+      for (int i = std::max(p * span, order); i < (p + 1) * span; ++i) {
+        writer.unary(folded[i] >> k);
+        if (k > 0) writer.put(folded[i], k);
+      }
+    }
+  }
+
+  writer.align();
+  writer.put(crc16(bytes.data(), bytes.size()), 16);
+
+  uint32_t size = (uint32_t)bytes.size();
+  min_frame_bytes = min_frame_bytes ? std::min(min_frame_bytes, size) : size;
+  max_frame_bytes = std::max(max_frame_bytes, size);
+  total_frames += frames;
+  ++frame_number;
+  if (std::fwrite(bytes.data(), 1, size, file) != size) failed = true;
+  return !failed;
+}
+
+bool FlacWriter::close() {
+  if (!file) return true;
+  bool ok = !failed && std::fseek(file, 8, SEEK_SET) == 0 &&
+            writeStreamInfo();
+  ok = std::fclose(file) == 0 && ok;
+  file = nullptr;
+  return ok;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file Flac.hpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Minimal FLAC encoder for bus recordings.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * Writes 24 bit FLAC with a fixed block size. Each channel of a block is
+ * stored as a constant, verbatim, or with whichever fixed polynomial
+ * predictor of order 0 to 4 codes smallest, its residual Rice coded in up to
+ * 64 partitions. That is most of what the reference encoder gains on
+ * synthesized material, at a fraction of the work.
+ *
+ * FLAC carries at most 8 channels per stream. No MD5 of the audio is stored.
+ */
+struct FlacWriter {
+  static const int BLOCK_SIZE = 4096;
+  static const int MAX_CHANNELS = 8;
+  static const int BITS = 24;
+
+  ~FlacWriter();
+  bool open(const std::string& path, int channels, int sample_rate);
+
+  /**
+   * Encodes one block of interleaved 24 bit samples. Every block but the
+   * last must hold exactly BLOCK_SIZE frames.
+   */
+  bool write(const int32_t* samples, int frames);
+
+  /** Fills in the stream info and closes the file. */
+  bool close();
+
+ private:
+  FILE* file = nullptr;
+  int channels = 0;
+  int sample_rate = 0;
+  int64_t total_frames = 0;
+  uint32_t frame_number = 0;
+  uint32_t min_frame_bytes = 0;
+  uint32_t max_frame_bytes = 0;
+  bool failed = false;
+
+  std::vector<uint8_t> bytes;
+  std::vector<int32_t> channel;
+  std::vector<int32_t> residual;
+  std::vector<uint32_t> folded;
+
+  bool writeStreamInfo();
+};
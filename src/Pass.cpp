@@ -9,21 +9,200 @@
  *
  */
 
+#include <osdialog.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "BusEngine.hpp"
+#include "BusRecorder.hpp"
+#include "Convolver.hpp"
 #include "plugin.hpp"
 
+using simd::float_4;
+
+// AGC settings, selectable from the context menu.
+static const int AGC_BLOCK = 64;
+static const float AGC_TARGETS[] = {1.f, 2.f, 3.5f, 5.f};
+static const float AGC_MAX_GAINS_DB[] = {6.f, 12.f, 24.f};
+static const float AGC_TIMES[] = {0.3f, 3.f, 30.f};
+
+// Freeze capture. The buffer is allocated when freeze is first armed, sized
+// for the longest loop at 16 channels and the engine rate, and pages are
+// only committed as recording touches them. The loop length is counted in
+// clock pulses, or in cycles of the bus itself when no clock is patched. A
+// capture that fills the buffer stops early, and the context menu shows how
+// much of it was kept.
+static const float FREEZE_MAX_SECONDS = 60.f;
+static const int FREEZE_LENGTHS[] = {1, 2, 4, 8, 16, 32};
+
+// Transient shaper envelope times in seconds. The fast follower tracks the
+// signal closely; the other two lag it on the attack or on the release.
+static const float SHAPER_FAST_ATTACK = 0.0005f;
+static const float SHAPER_FAST_RELEASE = 0.02f;
+static const float SHAPER_SLOW_ATTACK = 0.02f;
+static const float SHAPER_SLOW_RELEASE = 0.25f;
+
+// Voice collapse: adjacent poly channels are merged in groups of this size.
+static const int COLLAPSE_FACTORS[] = {1, 2, 4, 8};
+
+// Console emulation per drive setting: input and bus headroom in volts,
+// where the soft clip curve flattens out, and crosstalk from the rest of the
+// bus into each channel.
+static const float CONSOLE_INPUT_HEADROOM[] = {0.f, 24.f, 16.f, 11.f};
+static const float CONSOLE_BUS_HEADROOM[] = {0.f, 30.f, 22.f, 15.f};
+static const float CONSOLE_CROSSTALK[] = {0.f, 0.001f, 0.00316f, 0.01f};
+
+// Quantized mode switching: button presses wait for every Nth clock edge.
+// Edges are counted from when the clock is patched or the setting chosen,
+// not from each press, so changes stay aligned to the bar.
+static const int QUANTIZE_DIVISIONS[] = {0, 1, 2, 4, 8, 16};
+
+// Weighted AVG: below this total weight a channel is divided by the floor
+// instead, so it fades out smoothly as the weights go to zero.
+static const float WEIGHT_FLOOR = 0.01f;
+
+/**
+ * Cubic soft clip with unity gain at zero and zero slope at +-headroom,
+ * where it levels off at two thirds of the headroom. Branchless: the clamp
+ * is a min/max pair and the rest is a polynomial.
+ */
+static float_4 softClip(float_4 x, float headroom) {
+  float_4 limited = simd::clamp(x, -headroom, headroom);
+  float k = 1.f / (3.f * headroom * headroom);
+  return limited - k * limited * limited * limited;
+}
+
+// How often the IR worker frees an IR the audio thread has replaced.
+static const std::chrono::milliseconds IR_RECLAIM_POLL(100);
+
+// Longest chain of adjacent Pass modules one group leader runs.
+static const int GROUP_MAX = 64;
+
+// Band split points of the LOW/MID/HIGH outputs, selectable from the context
+// menu.
+static const float XOVER_LOW_FREQS[] = {100.f, 200.f, 400.f};
+static const float XOVER_HIGH_FREQS[] = {1500.f, 3000.f, 6000.f};
+
+/**
+ * Coefficients of one biquad section, normalized so that a0 = 1.
+ */
+struct BiquadCoefs {
+  float b0 = 0.f;
+  float b1 = 0.f;
+  float b2 = 0.f;
+  float a1 = 0.f;
+  float a2 = 0.f;
+};
+
+/**
+ * Transposed direct form II state of one biquad section for four channels.
+ */
+struct BiquadState {
+  float_4 z1 = 0.f;
+  float_4 z2 = 0.f;
+
+  float_4 process(const BiquadCoefs& k, float_4 x) {
+    float_4 y = k.b0 * x + z1;
+    z1 = k.b1 * x - k.a1 * y + z2;
+    z2 = k.b2 * x - k.a2 * y;
+    return y;
+  }
+};
+
+/**
+ * A three-band Linkwitz-Riley crossover for four channels. Each LR4 filter is
+ * two Butterworth sections; the low band also passes the allpass of the upper
+ * split so the three bands sum back to a flat, phase-coherent signal.
+ */
+struct CrossoverState {
+  BiquadState low[2];
+  BiquadState low_allpass;
+  BiquadState upper[2];
+  BiquadState mid[2];
+  BiquadState high[2];
+};
+
+/**
+ * What a Pass publishes about itself each frame through its left expander
+ * message, for the leader of its group.
+ */
+struct GroupFrame {
+  int64_t stamp = 0;
+  bool grouped = false;
+  bool groupable = false;
+  bool average = false;
+  bool active = false;
+  float in[3] = {};
+  float connected = 0.f;
+};
+
+/**
+ * What the group leader sends back to a member through the member's right
+ * expander message: its bus output for the frame with the same stamp.
+ */
+struct GroupResult {
+  int64_t stamp = -1;
+  bool active = false;
+  float out = 0.f;
+};
+
 struct Pass : Module {
-  enum ParamId { POWER_PARAM, SUM_PARAM, AVG_PARAM, PARAMS_LEN };
-  enum InputId { IN_1_INPUT, IN_2_INPUT, IN_3_INPUT, INPUTS_LEN };
-  enum OutputId { OUT_1_OUTPUT, OUTPUTS_LEN };
+  enum ParamId {
+    POWER_PARAM,
+    SUM_PARAM,
+    AVG_PARAM,
+    FREEZE_PARAM,
+    WIDTH_PARAM,
+    ATTACK_PARAM,
+    SUSTAIN_PARAM,
+    PARAMS_LEN
+  };
+  enum InputId {
+    IN_1_INPUT,
+    IN_2_INPUT,
+    IN_3_INPUT,
+    CLOCK_INPUT,
+    GATE_INPUT,
+    VCA_INPUT,
+    WEIGHT_INPUT,
+    INPUTS_LEN
+  };
+  enum OutputId {
+    OUT_1_OUTPUT,
+    LOW_OUTPUT,
+    MID_OUTPUT,
+    HIGH_OUTPUT,
+    LEFT_OUTPUT,
+    RIGHT_OUTPUT,
+    OUTPUTS_LEN
+  };
   enum LightId {
     POWER_LIGHT_LIGHT,
     SUM_LIGHT_LIGHT,
     AVG_LIGHT_LIGHT,
+    FREEZE_LIGHT_LIGHT,
     LIGHTS_LEN
   };
+  enum FreezeState {
+    FREEZE_LIVE,
+    FREEZE_ARMED,
+    FREEZE_RECORDING,
+    FREEZE_PLAYING
+  };
 
   int num_channels = 0;
-  std::vector<float> voltages;
+  int out_channels = 0;
+  int channel_layout = 0;
+  int input_channels[3] = {};
+  float_4 voltages[4] = {};
+  // Patches saved by the first release of Pass, which had no module data,
+  // keep its bus: OUT carries channel 1 only, and AVG divides by the total
+  // channel count of all inputs.
+  bool legacy_bus = false;
   bool state_on = false;
   bool last_state = false;
 
@@ -33,24 +212,238 @@ struct Pass : Module {
   bool state_on_sum = false;
   bool last_state_sum = false;
 
+  // Presses waiting for the quantize clock, as PENDING_* bits.
+  enum PendingMode { PENDING_POWER = 1, PENDING_SUM = 2, PENDING_AVG = 4 };
+  int quantize = 0;
+  int quantize_edges = 0;
+  int pending_modes = 0;
+  dsp::SchmittTrigger quantize_trigger;
+
+  bool agc_on = false;
+  int agc_target = 2;
+  int agc_max_gain = 1;
+  int agc_speed = 1;
+  int agc_frame = 0;
+  float_4 agc_sum_sq[4] = {};
+  float_4 agc_power[4] = {};
+  float_4 agc_log_gain[4] = {};
+  float_4 agc_gain[4] = {};
+  float_4 agc_gain_step[4] = {};
+
+  // AVG divides each channel by the number of inputs carrying it; the
+  // factors only change with the input layout.
+  int avg_layout = -1;
+  float_4 avg_factors[4] = {};
+
+  // Gated AVG: the mean of the voices whose gate is high. The set of gated
+  // voices only changes on gate edges or when the input layout changes, so
+  // its factors are cached between them.
+  dsp::TSchmittTrigger<float_4> gate_triggers[4];
+  int gate_bits = -1;
+  int gate_layout = -1;
+  int gate_voices = 0;
+  float_4 gate_factors[4] = {};
+  float gate_mean = 0.f;
+
+  // Weighted AVG: the per-channel total of the input weights this frame.
+  float_4 avg_weight[4] = {};
+
+  // Transient shaper: three envelope followers per channel, with their
+  // smoothing coefficients cached per sample rate.
+  float shaper_rate = 0.f;
+  float shaper_coefs[4] = {};
+  float_4 shaper_fast[4] = {};
+  float_4 shaper_slow_attack[4] = {};
+  float_4 shaper_slow_release[4] = {};
+
+  int collapse = 0;
+  int collapse_key = -1;
+
+  // Console emulation: drive on every input, crosstalk and saturation on
+  // the bus. 0 is off.
+  int console = 0;
+  float_4 collapse_recip[4] = {};
+
+  FreezeState freeze_state = FREEZE_LIVE;
+  bool last_state_freeze = false;
+  int freeze_length = 0;
+  int freeze_edges = 0;
+  int freeze_channels = 0;
+  int freeze_frames = 0;
+  int freeze_pos = 0;
+  bool freeze_full = false;
+  float freeze_last = 0.f;
+  // Floats in freeze_buffer, 0 until it is allocated.
+  int freeze_capacity = 0;
+  std::unique_ptr<float[]> freeze_buffer;
+  dsp::SchmittTrigger clock_trigger;
+
+  // Band split of the bus. Coefficients are only recomputed when the sample
+  // rate or a split point changes.
+  int xover_low = 1;
+  int xover_high = 1;
+  int xover_key = -1;
+  float xover_rate = 0.f;
+  BiquadCoefs xover_low_lp;
+  BiquadCoefs xover_low_hp;
+  BiquadCoefs xover_high_lp;
+  BiquadCoefs xover_high_hp;
+  BiquadCoefs xover_high_ap;
+  CrossoverState xover[4];
+
+  // Static-input short-circuit: the last input frame and the settings it
+  // was processed with. A layout of -1 forces the next frame through.
+  float_4 last_inputs[3][4] = {};
+  int last_layout = -1;
+  int last_settings = -1;
+  float last_width = -1.f;
+
+  // Group processing: the leftmost of a row of grouped Pass modules runs the
+  // plain mono SUM/AVG bus of the whole row. Modules only exchange state
+  // through Rack's double-buffered expander messages, which the engine flips
+  // between frames: each module publishes a GroupFrame on its left expander,
+  // and the leader answers on each member's right expander. Each side only
+  // reads consumer buffers and writes its own producer buffer, so results
+  // arrive two frames after the inputs, whatever order the threads run in.
+  // Grouped outputs therefore lag by two samples, and skip or repeat two
+  // when grouping starts or stops.
+  bool group_on = false;
+  int64_t group_stamp = 0;
+  GroupFrame group_frames[2];
+  GroupResult group_results[2];
+
+  // Stereo spread. Pan gains only change with the channel count or width.
+  int spread_channels = -1;
+  float spread_width = -1.f;
+  float_4 spread_left[4] = {};
+  float_4 spread_right[4] = {};
+
+  // Convolution insert. IRs are loaded on a worker thread and handed to the
+  // audio thread through ir_pending; the one it replaces goes back through
+  // ir_retired and is freed by the worker, never on the audio thread.
+  // Requests only post the path and rate under ir_mutex, so neither the UI
+  // nor a sample rate change ever waits for a load.
+  std::mutex ir_mutex;
+  std::condition_variable ir_wake;
+  std::string ir_path;
+  float ir_rate = 0.f;
+  bool ir_requested = false;
+  bool ir_stop = false;
+  std::thread ir_loader;
+  std::atomic<Convolver*> ir_pending{nullptr};
+  std::atomic<Convolver*> ir_retired{nullptr};
+  std::atomic<bool> ir_failed{false};
+  Convolver* ir_active = nullptr;
+
+  // Recording of the main output to FLAC, encoded off the audio thread.
+  BusRecorder recorder;
+
+  // Diagnostics, from the context menu only: a scalar reference of the
+  // SUM/AVG core runs alongside the SIMD path. Their difference can replace
+  // the bus on the main output.
+  bool diag_on = false;
+  bool diag_null = false;
+  float diag_max_error = 0.f;
+  float diag_held = 0.f;
+  int diag_channels = 0;
+  float diag_error[16] = {};
+
   Pass() {
     config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
     configButton(Pass::POWER_PARAM, "Power Trigger");
     configButton(Pass::SUM_PARAM, "Sum Trigger");
     configButton(Pass::AVG_PARAM, "AVG Trigger");
+    configButton(Pass::FREEZE_PARAM, "Freeze Trigger");
+    configParam(Pass::WIDTH_PARAM, 0.f, 1.f, 1.f, "Stereo Width", "%", 0.f,
+                100.f);
+    configParam(Pass::ATTACK_PARAM, -12.f, 12.f, 0.f, "Transient Attack",
+                " dB");
+    configParam(Pass::SUSTAIN_PARAM, -12.f, 12.f, 0.f, "Transient Sustain",
+                " dB");
 
     configInput(Pass::IN_1_INPUT, "Track 1");
     configInput(Pass::IN_2_INPUT, "Track 2");
     configInput(Pass::IN_3_INPUT, "Track 3");
+    configInput(Pass::CLOCK_INPUT, "Clock");
+    configInput(Pass::GATE_INPUT, "AVG Gate");
+    configInput(Pass::VCA_INPUT, "Output VCA");
+    configInput(Pass::WEIGHT_INPUT, "AVG Weights");
 
     configOutput(Pass::OUT_1_OUTPUT, "Audio Output");
+    configOutput(Pass::LOW_OUTPUT, "Low Band");
+    configOutput(Pass::MID_OUTPUT, "Mid Band");
+    configOutput(Pass::HIGH_OUTPUT, "High Band");
+    configOutput(Pass::LEFT_OUTPUT, "Stereo Left");
+    configOutput(Pass::RIGHT_OUTPUT, "Stereo Right");
 
     configLight(Pass::POWER_LIGHT_LIGHT, "Power Status");
     configLight(Pass::SUM_LIGHT_LIGHT, "Sum Status");
     configLight(Pass::AVG_LIGHT_LIGHT, "Avg Status");
+    configLight(Pass::FREEZE_LIGHT_LIGHT, "Freeze Status");
+
+    leftExpander.producerMessage = &group_frames[0];
+    leftExpander.consumerMessage = &group_frames[1];
+    rightExpander.producerMessage = &group_results[0];
+    rightExpander.consumerMessage = &group_results[1];
+
+    resetAgc();
+  }
+
+  ~Pass() {
+    {
+      std::lock_guard<std::mutex> lock(ir_mutex);
+      ir_stop = true;
+    }
+    ir_wake.notify_one();
+    if (ir_loader.joinable()) {
+      ir_loader.join();
+    }
+    delete ir_pending.exchange(nullptr);
+    delete ir_retired.exchange(nullptr);
+    delete ir_active;
+  }
+
+  void onSampleRateChange(const SampleRateChangeEvent& e) override {
+    std::string path;
+    float rate;
+    {
+      std::lock_guard<std::mutex> lock(ir_mutex);
+      path = ir_path;
+      rate = ir_rate;
+    }
+    if (!path.empty() && e.sampleRate != rate) {
+      loadImpulse(path, e.sampleRate);
+    }
+
+    // The next arm sizes the freeze buffer for the new rate.
+    if (freeze_state == FREEZE_LIVE) {
+      freeze_buffer.reset();
+      freeze_capacity = 0;
+    }
   }
 
   void process(const ProcessArgs& args) override {
+    // The output still holds the previous frame, whichever path produced it
+    // and even when the bus is skipped or run by a group leader.
+    if (recorder.active()) {
+      recordOutput();
+    }
+
+    bool grouped = groupable();
+    if (grouped) {
+      updateGroupedStates();
+    }
+    publishGroupFrame(grouped);
+    if (leadsGroup()) {
+      processGroup();
+    }
+    // Until the leader's first result arrives, and past GROUP_MAX, the
+    // module runs its own bus.
+    if (grouped && receiveGroupResult()) {
+      last_layout = -1;
+      return;
+    }
+
     updatePowerState();
 
     if (!state_on) {
@@ -58,8 +451,20 @@ struct Pass : Module {
       return;
     } else {
       updateModeStates();
+      updateFreezeState(args.sampleRate);
+
+      if (freeze_state == FREEZE_PLAYING) {
+        diag_channels = 0;
+        playFreeze();
+        applyConvolution();
+        applyCrossover(args.sampleRate);
+        applySpread();
+        sendOutput();
+        return;
+      }
 
       if (state_on_sum || state_on_avg) {
+        if (inputsStatic()) return;
         processInputs();
       }
 
@@ -67,84 +472,1178 @@ struct Pass : Module {
         if (state_on_avg) {
           applyAverage();
         }
+        if (diag_on) {
+          compareReference();
+        }
+        if (console > 0) {
+          applyConsole();
+        }
+        if (collapse > 0) {
+          applyCollapse();
+        }
+        if (agc_on) {
+          applyAgc(args.sampleTime);
+        }
+        applyShaper(args.sampleRate);
+        if (freeze_state != FREEZE_LIVE) {
+          recordFreeze();
+        }
+        applyConvolution();
+        applyCrossover(args.sampleRate);
+        applySpread();
         sendOutput();
       }
     }
   }
 
   void updatePowerState() {
+    updateQuantizer();
+
     bool current_state = params[POWER_PARAM].getValue() == 1;
     if (current_state && !last_state) {
-      state_on = !state_on;
+      if (quantizing()) {
+        pending_modes ^= PENDING_POWER;
+      } else {
+        state_on = !state_on;
+      }
     }
     last_state = current_state;
 
-    lights[POWER_LIGHT_LIGHT].setBrightness(state_on ? 1.0f : 0.0f);
+    float brightness = state_on ? 1.0f : 0.0f;
+    if (pending_modes & PENDING_POWER) {
+      brightness = 0.5f;
+    }
+    lights[POWER_LIGHT_LIGHT].setBrightness(brightness);
+  }
+
+  bool quantizing() {
+    return quantize > 0 && inputs[CLOCK_INPUT].isConnected();
+  }
+
+  /**
+   * Counts quantize clock edges and applies the latched presses on every
+   * Nth. Presses still pending when the clock is unpatched or the setting
+   * turned off apply at once.
+   */
+  void updateQuantizer() {
+    bool edge = false;
+    if (quantizing()) {
+      if (quantize_trigger.process(inputs[CLOCK_INPUT].getVoltage(), 0.1f,
+                                   1.f)) {
+        quantize_edges = (quantize_edges + 1) % QUANTIZE_DIVISIONS[quantize];
+        edge = quantize_edges == 0;
+      }
+    } else {
+      quantize_edges = 0;
+      edge = true;
+    }
+    if (!edge || pending_modes == 0) return;
+
+    if (pending_modes & PENDING_POWER) {
+      state_on = !state_on;
+    }
+    if (pending_modes & PENDING_SUM) {
+      state_on_sum = true;
+      state_on_avg = false;
+    } else if (pending_modes & PENDING_AVG) {
+      state_on_avg = true;
+      state_on_sum = false;
+    }
+    pending_modes = 0;
   }
 
   void updateModeStates() {
     bool current_state_sum = params[SUM_PARAM].getValue() == 1;
     if (current_state_sum && !last_state_sum) {
-      state_on_sum = true;
-      state_on_avg = false;
+      if (quantizing()) {
+        pending_modes = (pending_modes & ~PENDING_AVG) | PENDING_SUM;
+      } else {
+        state_on_sum = true;
+        state_on_avg = false;
+      }
     }
     last_state_sum = current_state_sum;
 
     bool current_state_avg = params[AVG_PARAM].getValue() == 1;
     if (current_state_avg && !last_state_avg) {
-      state_on_avg = true;
-      state_on_sum = false;
+      if (quantizing()) {
+        pending_modes = (pending_modes & ~PENDING_SUM) | PENDING_AVG;
+      } else {
+        state_on_avg = true;
+        state_on_sum = false;
+      }
     }
     last_state_avg = current_state_avg;
 
-    lights[SUM_LIGHT_LIGHT].setBrightness(state_on_sum ? 1.0f : 0.0f);
-    lights[AVG_LIGHT_LIGHT].setBrightness(state_on_avg ? 1.0f : 0.0f);
+    // A pending mode shows at half brightness until its clock edge.
+    float sum_brightness = state_on_sum ? 1.0f : 0.0f;
+    float avg_brightness = state_on_avg ? 1.0f : 0.0f;
+    if (pending_modes & PENDING_SUM) {
+      sum_brightness = 0.5f;
+    } else if (pending_modes & PENDING_AVG) {
+      avg_brightness = 0.5f;
+    }
+    lights[SUM_LIGHT_LIGHT].setBrightness(sum_brightness);
+    lights[AVG_LIGHT_LIGHT].setBrightness(avg_brightness);
+  }
+
+  void updateFreezeState(float sample_rate) {
+    bool current_state_freeze = params[FREEZE_PARAM].getValue() == 1;
+    if (current_state_freeze && !last_state_freeze) {
+      freeze_state = freeze_state == FREEZE_LIVE ? FREEZE_ARMED : FREEZE_LIVE;
+      freeze_edges = 0;
+      freeze_last = 0.f;
+      if (freeze_state == FREEZE_ARMED && !freeze_buffer) {
+        // Left uninitialized, so this only reserves address space.
+        freeze_capacity = freezeCapacity(sample_rate);
+        freeze_buffer.reset(new float[freeze_capacity + 4]);
+      }
+    }
+    last_state_freeze = current_state_freeze;
+
+    float brightness = freeze_state == FREEZE_PLAYING ? 1.0f : 0.0f;
+    if (freeze_state == FREEZE_ARMED || freeze_state == FREEZE_RECORDING) {
+      brightness = 0.5f;
+    }
+    lights[FREEZE_LIGHT_LIGHT].setBrightness(brightness);
+  }
+
+  /**
+   * Returns `module` if it is an active Pass that took part in a group last
+   * frame, going by the frame it published.
+   */
+  static Pass* groupedPass(Module* module) {
+    if (!module || module->model != modelPass || module->isBypassed()) {
+      return nullptr;
+    }
+    Pass* pass = static_cast<Pass*>(module);
+    return pass->publishedFrame()->grouped ? pass : nullptr;
+  }
+
+  /**
+   * Whether this module runs its row this frame. Decided, like the walk in
+   * processGroup(), from the frames published last frame only, which every
+   * module sees the same. A row thus has one leader even in the frame a
+   * neighbour joins or leaves it, and only that leader writes the members'
+   * right expander producers.
+   */
+  bool leadsGroup() {
+    return groupedPass(this) && !groupedPass(leftExpander.module);
+  }
+
+  const GroupFrame* publishedFrame() {
+    return static_cast<const GroupFrame*>(leftExpander.consumerMessage);
+  }
+
+  void publishGroupFrame(bool grouped) {
+    GroupFrame* frame = static_cast<GroupFrame*>(leftExpander.producerMessage);
+    frame->stamp = ++group_stamp;
+    frame->grouped = group_on;
+    frame->groupable = grouped;
+    if (grouped) {
+      frame->average = state_on_avg;
+      frame->active = state_on && (state_on_sum || state_on_avg);
+      frame->connected = 0.f;
+      for (int i = 0; i < 3; ++i) {
+        bool connected = inputs[IN_1_INPUT + i].isConnected();
+        frame->in[i] = connected ? inputs[IN_1_INPUT + i].getVoltage() : 0.f;
+        frame->connected += connected ? 1.f : 0.f;
+      }
+    }
+    leftExpander.requestMessageFlip();
+  }
+
+  /**
+   * Sends the leader's result for the frame published two frames ago.
+   * Returns false when there is none.
+   */
+  bool receiveGroupResult() {
+    const GroupResult* result =
+        static_cast<const GroupResult*>(rightExpander.consumerMessage);
+    if (result->stamp != group_stamp - 2) return false;
+    // setChannels(0) zeroes the output but leaves it one channel wide, so an
+    // inactive member must not write the group sum after it.
+    Output& output = outputs[OUT_1_OUTPUT];
+    output.setChannels(result->active ? 1 : 0);
+    if (result->active) {
+      output.setVoltage(result->out);
+    }
+    return true;
+  }
+
+  bool shaperActive() {
+    return params[ATTACK_PARAM].getValue() != 0.f ||
+           params[SUSTAIN_PARAM].getValue() != 0.f;
+  }
+
+  /**
+   * Whether the group leader runs this module instead of the module itself:
+   * only plain mono SUM/AVG without any of the per-module extras. Only the
+   * module evaluates this; the leader sees the answer in its GroupFrame.
+   */
+  bool groupable() {
+    if (!group_on || agc_on || collapse > 0 || console > 0 || diag_on) {
+      return false;
+    }
+    // A recording reads the bus the module runs itself.
+    if (recorder.active()) return false;
+    if (freeze_state != FREEZE_LIVE || shaperActive()) return false;
+    if (ir_pending.load() || (ir_active && !ir_active->empty())) return false;
+    if (inputs[CLOCK_INPUT].isConnected() ||
+        inputs[GATE_INPUT].isConnected() ||
+        inputs[VCA_INPUT].isConnected() ||
+        inputs[WEIGHT_INPUT].isConnected()) {
+      return false;
+    }
+    for (int o = OUT_1_OUTPUT + 1; o < OUTPUTS_LEN; ++o) {
+      if (outputs[o].isConnected()) return false;
+    }
+    for (int i = IN_1_INPUT; i <= IN_3_INPUT; ++i) {
+      if (inputs[i].getChannels() > 1) return false;
+    }
+    return true;
+  }
+
+  /**
+   * Runs SUM/AVG for every groupable module in the row starting here, from
+   * the frames they published last frame. Four modules share each float_4,
+   * one lane per module, with their inputs gathered structure-of-arrays;
+   * each result goes to the member's right expander producer, which only
+   * the leader writes.
+   */
+  void processGroup() {
+    Pass* members[GROUP_MAX];
+    int count = 0;
+    for (Pass* pass = this; pass && count < GROUP_MAX;
+         pass = groupedPass(pass->rightExpander.module)) {
+      if (pass->publishedFrame()->groupable) {
+        members[count++] = pass;
+      }
+    }
+
+    for (int m = 0; m < count; m += 4) {
+      int lanes = std::min(4, count - m);
+      float in[3][4] = {};
+      float connected[4] = {};
+      float average[4] = {};
+      for (int lane = 0; lane < lanes; ++lane) {
+        const GroupFrame* frame = members[m + lane]->publishedFrame();
+        for (int i = 0; i < 3; ++i) {
+          in[i][lane] = frame->in[i];
+        }
+        connected[lane] = frame->connected;
+        average[lane] = frame->average ? 1.f : 0.f;
+      }
+
+      float_4 sum = float_4::load(in[0]) + float_4::load(in[1]) +
+                    float_4::load(in[2]);
+      float_4 inputs_n = float_4::load(connected);
+      float_4 avg = sum / simd::fmax(inputs_n, 1.f);
+      float_4 out = simd::ifelse(float_4::load(average) > 0.f, avg, sum);
+
+      for (int lane = 0; lane < lanes; ++lane) {
+        Pass* pass = members[m + lane];
+        const GroupFrame* frame = pass->publishedFrame();
+        GroupResult* result =
+            static_cast<GroupResult*>(pass->rightExpander.producerMessage);
+        result->stamp = frame->stamp;
+        result->active = frame->active && connected[lane] > 0.f;
+        result->out = out[lane];
+        pass->rightExpander.requestMessageFlip();
+      }
+    }
+  }
+
+  /**
+   * Button and light handling of a module whose bus the leader runs.
+   */
+  void updateGroupedStates() {
+    updatePowerState();
+    if (state_on) {
+      updateModeStates();
+      return;
+    }
+    state_on_sum = false;
+    state_on_avg = false;
+    lights[SUM_LIGHT_LIGHT].setBrightness(0.0f);
+    lights[AVG_LIGHT_LIGHT].setBrightness(0.0f);
+  }
+
+  /**
+   * Counts loop boundaries: clock edges when a clock is patched, otherwise
+   * rising zero crossings of the first bus channel.
+   */
+  bool freezeEdge() {
+    if (inputs[CLOCK_INPUT].isConnected()) {
+      return clock_trigger.process(inputs[CLOCK_INPUT].getVoltage(), 0.1f,
+                                   1.f);
+    }
+    float current = voltages[0][0];
+    bool edge = freeze_last <= 0.f && current > 0.f;
+    freeze_last = current;
+    return edge;
+  }
+
+  void recordFreeze() {
+    bool edge = freezeEdge();
+
+    if (freeze_state == FREEZE_ARMED) {
+      if (!edge) return;
+      freeze_state = FREEZE_RECORDING;
+      freeze_channels = out_channels;
+      freeze_frames = 0;
+      freeze_full = false;
+    } else if (edge && ++freeze_edges >= FREEZE_LENGTHS[freeze_length]) {
+      startFreezePlayback();
+      return;
+    }
+
+    // Frames are packed at a stride of freeze_channels; the spare lanes of
+    // the last block spill into the next frame and get overwritten by it.
+    int offset = freeze_frames * freeze_channels;
+    for (int c = 0; c < freeze_channels; c += 4) {
+      voltages[c / 4].store(&freeze_buffer[offset + c]);
+    }
+    if (++freeze_frames * freeze_channels > freeze_capacity - 16) {
+      freeze_full = true;
+      startFreezePlayback();
+    }
+  }
+
+  static int freezeCapacity(float sample_rate) {
+    return (int)(FREEZE_MAX_SECONDS * sample_rate) * 16;
+  }
+
+  /** Length of the loop, or how long a capture can get, for the menu. */
+  std::string freezeStatus() {
+    float sample_rate = APP->engine->getSampleRate();
+    if (freeze_state == FREEZE_PLAYING) {
+      std::string status =
+          string::f("Loop: %.2f s", freeze_frames / sample_rate);
+      if (freeze_full) {
+        status += string::f(" (buffer full after %d of %d cycles)",
+                            freeze_edges, FREEZE_LENGTHS[freeze_length]);
+      }
+      return status;
+    }
+    int channels = std::max(out_channels, 1);
+    int capacity =
+        freeze_capacity > 0 ? freeze_capacity : freezeCapacity(sample_rate);
+    return string::f("Longest loop: %.2f s at %d channels",
+                     (capacity - 16) / channels / sample_rate, channels);
+  }
+
+  void startFreezePlayback() {
+    freeze_state = freeze_frames > 0 ? FREEZE_PLAYING : FREEZE_LIVE;
+    freeze_pos = 0;
+  }
+
+  void playFreeze() {
+    out_channels = freeze_channels;
+    int offset = freeze_pos * freeze_channels;
+    for (int c = 0; c < freeze_channels; c += 4) {
+      voltages[c / 4] = float_4::load(&freeze_buffer[offset + c]);
+    }
+    if (++freeze_pos >= freeze_frames) {
+      freeze_pos = 0;
+    }
+  }
+
+  /**
+   * True when every input, setting and output connection is identical to
+   * the previous frame and only stateless stages are active, so the outputs
+   * still hold this frame's result and the whole bus can be skipped.
+   */
+  bool inputsStatic() {
+    if (agc_on || freeze_state != FREEZE_LIVE || shaperActive() ||
+        inputs[GATE_INPUT].isConnected() ||
+        inputs[VCA_INPUT].isConnected() ||
+        inputs[WEIGHT_INPUT].isConnected() || ir_pending.load() ||
+        (ir_active && !ir_active->empty()) ||
+        outputs[LOW_OUTPUT].isConnected() ||
+        outputs[MID_OUTPUT].isConnected() ||
+        outputs[HIGH_OUTPUT].isConnected()) {
+      last_layout = -1;
+      return false;
+    }
+
+    int layout = 0;
+    __m128i diff = _mm_setzero_si128();
+    for (int i = 0; i < 3; ++i) {
+      Input& input = inputs[IN_1_INPUT + i];
+      int channels = input.getChannels();
+      layout = (layout << 5) | channels;
+      for (int c = 0; c < channels; c += 4) {
+        float_4 voltage = input.getVoltageSimd<float_4>(c);
+        diff = _mm_or_si128(
+            diff, _mm_xor_si128(_mm_castps_si128(voltage.v),
+                                _mm_castps_si128(last_inputs[i][c / 4].v)));
+        last_inputs[i][c / 4] = voltage;
+      }
+    }
+    // An output patched since the last frame starts out one channel wide
+    // at 0 V, so its connection state is part of the key too.
+    int settings = state_on_sum | state_on_avg << 1 | diag_on << 2 |
+                   collapse << 3 | console << 5 | diag_null << 7 |
+                   outputs[OUT_1_OUTPUT].isConnected() << 8 |
+                   outputs[LEFT_OUTPUT].isConnected() << 9 |
+                   outputs[RIGHT_OUTPUT].isConnected() << 10 |
+                   legacy_bus << 11;
+    float width = params[WIDTH_PARAM].getValue();
+
+    bool unchanged = _mm_testz_si128(diff, diff) && layout == last_layout &&
+                     settings == last_settings && width == last_width;
+    last_layout = layout;
+    last_settings = settings;
+    last_width = width;
+    return unchanged;
   }
 
   void processInputs() {
-    voltages.clear();
+    for (float_4& voltage : voltages) {
+      voltage = 0.f;
+    }
     num_channels = 0;
-    processInput(inputs[IN_1_INPUT]);
-    processInput(inputs[IN_2_INPUT]);
-    processInput(inputs[IN_3_INPUT]);
+    out_channels = 0;
+    channel_layout = 0;
+    if (weighted()) {
+      for (float_4& weight : avg_weight) {
+        weight = 0.f;
+      }
+    }
+    for (int i = 0; i < 3; ++i) {
+      processInput(inputs[IN_1_INPUT + i], i);
+    }
   }
 
-  void processInput(Input& input) {
+  void processInput(Input& input, int index) {
+    input_channels[index] = 0;
     if (!input.isConnected()) return;
 
     int channels = input.getChannels();
-    if (channels > voltages.size()) {
-      voltages.resize(channels, 0.0f);
+    input_channels[index] = channels;
+    out_channels = std::max(out_channels, channels);
+    channel_layout = (channel_layout << 5) | channels;
+
+    float_4 blocks[4];
+    int rows = BusEngine::rows(channels);
+    for (int b = 0; b < rows; ++b) {
+      blocks[b] = input.getVoltageSimd<float_4>(b * 4);
+    }
+    if (console > 0) {
+      for (int b = 0; b < rows; ++b) {
+        blocks[b] = softClip(blocks[b], CONSOLE_INPUT_HEADROOM[console]);
+      }
     }
+    if (weighted()) {
+      float weight = inputWeight(index);
+      for (int b = 0; b < rows; ++b) {
+        float_4 lane = float_4(0.f, 1.f, 2.f, 3.f) + 4.f * b;
+        blocks[b] *= weight;
+        avg_weight[b] += simd::ifelse(lane < float_4(channels), weight, 0.f);
+      }
+    }
+    BusEngine::accumulate(voltages, blocks, rows);
 
-    std::vector<float> inputVoltages(channels);
-    input.readVoltages(inputVoltages.data());
+    num_channels += channels;
+  }
 
-    for (int i = 0; i < channels; ++i) {
-      voltages[i] += inputVoltages[i];
-    }
+  /** AVG with a patched weight CV: channel `i` of it weights input `i`. */
+  bool weighted() {
+    return state_on_avg && inputs[WEIGHT_INPUT].isConnected();
+  }
 
-    num_channels += input.getChannels();
+  /**
+   * Weight of input `index`, 0 to 1 for 0 to 10 V. A mono CV weights every
+   * input alike; inputs past the channels of a poly CV get full weight.
+   */
+  float inputWeight(int index) {
+    Input& weight = inputs[WEIGHT_INPUT];
+    int channels = weight.getChannels();
+    if (channels > 1 && index >= channels) return 1.f;
+    return clamp(weight.getPolyVoltage(index) * 0.1f, 0.f, 1.f);
   }
 
   void applyAverage() {
-    for (float& voltage : voltages) {
-      voltage /= num_channels;
+    if (weighted()) {
+      applyWeightedAverage();
+      return;
+    }
+    if (inputs[GATE_INPUT].isConnected()) {
+      applyGatedAverage();
+      return;
+    }
+
+    if (legacy_bus) {
+      float_4 factor = 1.f / num_channels;
+      for (int c = 0; c < out_channels; c += 4) {
+        voltages[c / 4] *= factor;
+      }
+      return;
+    }
+    if (channel_layout != avg_layout) {
+      avg_layout = channel_layout;
+      BusEngine::averageFactors(input_channels, avg_factors);
+    }
+    for (int c = 0; c < out_channels; c += 4) {
+      voltages[c / 4] *= avg_factors[c / 4];
+    }
+  }
+
+  /**
+   * Replaces the bus by one channel: the mean of the voices whose gate is
+   * high, each voice averaged over the inputs carrying it. Released voices
+   * drop out of the mean; while no voice is gated the last mean is held.
+   */
+  void applyGatedAverage() {
+    Input& gate = inputs[GATE_INPUT];
+    int bits = 0;
+    for (int c = 0; c < out_channels; c += 4) {
+      gate_triggers[c / 4].process(gate.getPolyVoltageSimd<float_4>(c), 0.1f,
+                                   1.f);
+      bits |= simd::movemask(gate_triggers[c / 4].isHigh()) << c;
+    }
+    bits &= (1 << out_channels) - 1;
+
+    if (bits != gate_bits || channel_layout != gate_layout) {
+      gate_bits = bits;
+      gate_layout = channel_layout;
+      gate_voices = BusEngine::gatedFactors(input_channels, bits, gate_factors);
+    }
+
+    if (gate_voices > 0) {
+      float_4 total = 0.f;
+      for (int c = 0; c < out_channels; c += 4) {
+        total += voltages[c / 4] * gate_factors[c / 4];
+      }
+      __m128 sums = _mm_hadd_ps(total.v, total.v);
+      gate_mean = _mm_cvtss_f32(_mm_hadd_ps(sums, sums));
+    }
+    voltages[0] = float_4(gate_mean, 0.f, 0.f, 0.f);
+    out_channels = 1;
+  }
+
+  /**
+   * Divides each channel by the total weight of the inputs carrying it. The
+   * weights change every frame, so the division is a reciprocal estimate
+   * refined by one Newton step, accurate to about 23 bits.
+   */
+  void applyWeightedAverage() {
+    for (int c = 0; c < out_channels; c += 4) {
+      int b = c / 4;
+      float_4 total = simd::fmax(avg_weight[b], WEIGHT_FLOOR);
+      float_4 recip = simd::rcp(total);
+      recip *= 2.f - total * recip;
+      voltages[b] *= recip;
+    }
+  }
+
+  /**
+   * Bleeds a little of the whole bus into every channel, like neighbouring
+   * strips on a console summing amp, then saturates the bus. The bus total
+   * is reduced once per frame with horizontal adds; lanes past the last
+   * channel are masked out of it.
+   */
+  void applyConsole() {
+    float_4 total = 0.f;
+    for (int c = 0; c < out_channels; c += 4) {
+      float_4 lane = float_4(0.f, 1.f, 2.f, 3.f) + c;
+      total += simd::ifelse(lane < float_4(out_channels), voltages[c / 4], 0.f);
+    }
+    __m128 sums = _mm_hadd_ps(total.v, total.v);
+    total = float_4(_mm_hadd_ps(sums, sums));
+
+    float crosstalk = CONSOLE_CROSSTALK[console];
+    float headroom = CONSOLE_BUS_HEADROOM[console];
+    for (int c = 0; c < out_channels; c += 4) {
+      int b = c / 4;
+      float_4 bleed = (total - voltages[b]) * crosstalk;
+      voltages[b] = softClip(voltages[b] + bleed, headroom);
+    }
+  }
+
+  /**
+   * Merges groups of adjacent channels by repeated horizontal pair adds,
+   * halving the channel count each round. In AVG mode each merged channel is
+   * divided by the number of voices that went into it.
+   */
+  void applyCollapse() {
+    int factor = COLLAPSE_FACTORS[collapse];
+    int channels = out_channels;
+
+    // Lanes past the last channel may hold stale values from a wider bus.
+    int tail = channels % 4;
+    if (tail) {
+      float_4 lane = float_4(0.f, 1.f, 2.f, 3.f);
+      voltages[channels / 4] =
+          simd::ifelse(lane < float_4(tail), voltages[channels / 4], 0.f);
+    }
+
+    for (int f = 1; f < factor; f *= 2) {
+      int blocks = (channels + 3) / 4;
+      for (int b = 0; b < (blocks + 1) / 2; ++b) {
+        float_4 high = 2 * b + 1 < blocks ? voltages[2 * b + 1] : 0.f;
+        voltages[b] = float_4(_mm_hadd_ps(voltages[2 * b].v, high.v));
+      }
+      channels = (channels + 1) / 2;
+    }
+
+    if (state_on_avg) {
+      int key = out_channels * 16 + collapse;
+      if (key != collapse_key) {
+        collapse_key = key;
+        updateCollapseCounts();
+      }
+      for (int c = 0; c < channels; c += 4) {
+        voltages[c / 4] *= collapse_recip[c / 4];
+      }
+    }
+    out_channels = channels;
+  }
+
+  void updateCollapseCounts() {
+    int factor = COLLAPSE_FACTORS[collapse];
+    for (int c = 0; c < 16; ++c) {
+      int voices = clamp(out_channels - c * factor, 0, factor);
+      collapse_recip[c / 4][c % 4] = voices > 0 ? 1.f / voices : 0.f;
+    }
+  }
+
+  /**
+   * Boosts or cuts attacks and tails. The attack strength is how far the
+   * slow-attack envelope lags the fast one, the sustain strength how far the
+   * fast envelope has decayed below the slow-release one; both run from 0 to
+   * 1 and scale the ATTACK and SUSTAIN amounts, applied through a fast exp2.
+   */
+  void applyShaper(float sample_rate) {
+    float attack_db = params[ATTACK_PARAM].getValue();
+    float sustain_db = params[SUSTAIN_PARAM].getValue();
+    if (attack_db == 0.f && sustain_db == 0.f) return;
+
+    if (sample_rate != shaper_rate) {
+      shaper_rate = sample_rate;
+      const float times[4] = {SHAPER_FAST_ATTACK, SHAPER_FAST_RELEASE,
+                              SHAPER_SLOW_ATTACK, SHAPER_SLOW_RELEASE};
+      for (int i = 0; i < 4; ++i) {
+        shaper_coefs[i] = 1.f - std::exp(-1.f / (times[i] * sample_rate));
+      }
+    }
+
+    // dB to log2 of the gain.
+    float_4 attack = attack_db * (std::log2(10.f) / 20.f);
+    float_4 sustain = sustain_db * (std::log2(10.f) / 20.f);
+    for (int c = 0; c < out_channels; c += 4) {
+      int b = c / 4;
+      float_4 level = simd::fabs(voltages[b]) + 1e-6f;
+
+      float_4 rising = level > shaper_fast[b];
+      shaper_fast[b] += (level - shaper_fast[b]) *
+                        simd::ifelse(rising, shaper_coefs[0], shaper_coefs[1]);
+      rising = level > shaper_slow_attack[b];
+      shaper_slow_attack[b] +=
+          (level - shaper_slow_attack[b]) *
+          simd::ifelse(rising, shaper_coefs[2], shaper_coefs[1]);
+      rising = level > shaper_slow_release[b];
+      shaper_slow_release[b] +=
+          (level - shaper_slow_release[b]) *
+          simd::ifelse(rising, shaper_coefs[0], shaper_coefs[3]);
+
+      float_4 attack_amount = simd::clamp(
+          1.f - shaper_slow_attack[b] * simd::rcp(shaper_fast[b]), 0.f, 1.f);
+      float_4 sustain_amount = simd::clamp(
+          1.f - shaper_fast[b] * simd::rcp(shaper_slow_release[b]), 0.f,
+          1.f);
+      voltages[b] *= dsp::exp2_taylor5(attack * attack_amount +
+                                       sustain * sustain_amount);
+    }
+  }
+
+  /**
+   * Recomputes the bus one channel at a time, the way the SIMD path is meant
+   * to behave, and keeps the difference for the main output. Gated AVG
+   * reuses the gate states sampled by applyGatedAverage() and is compared
+   * on its single output channel.
+   */
+  void compareReference() {
+    bool gated = state_on_avg && !weighted() &&
+                 inputs[GATE_INPUT].isConnected();
+    int bus_channels =
+        gated ? BusEngine::outputChannels(input_channels) : out_channels;
+    float gated_total = 0.f;
+    int gated_voices = 0;
+    diag_channels = out_channels;
+    for (int c = 0; c < bus_channels; ++c) {
+      float sum = 0.f;
+      float weights = 0.f;
+      int count = 0;
+      for (int i = IN_1_INPUT; i <= IN_3_INPUT; ++i) {
+        if (!inputs[i].isConnected()) continue;
+        int channels = inputs[i].getChannels();
+        if (c < channels) {
+          float voltage = inputs[i].getVoltage(c);
+          if (console > 0) {
+            voltage =
+                softClip(voltage, CONSOLE_INPUT_HEADROOM[console])[0];
+          }
+          if (weighted()) {
+            float weight = inputWeight(i - IN_1_INPUT);
+            voltage *= weight;
+            weights += weight;
+          }
+          sum += voltage;
+          ++count;
+        }
+      }
+
+      float reference = sum;
+      if (weighted()) {
+        reference = sum / std::max(weights, WEIGHT_FLOOR);
+      } else if (gated) {
+        if (gate_bits & (1 << c)) {
+          gated_total += sum / count;
+          ++gated_voices;
+        }
+        continue;
+      } else if (state_on_avg) {
+        reference = sum / (legacy_bus ? num_channels : count);
+      }
+      storeDiagError(c, reference);
+    }
+
+    if (gated) {
+      if (gated_voices > 0) {
+        diag_held = gated_total / gated_voices;
+      }
+      storeDiagError(0, diag_held);
+    }
+  }
+
+  void storeDiagError(int c, float reference) {
+    float error = voltages[c / 4][c % 4] - reference;
+    diag_error[c] = error;
+    diag_max_error = std::max(diag_max_error, std::fabs(error));
+  }
+
+  void setDiagnostics(bool on) {
+    diag_on = on;
+    diag_max_error = 0.f;
+    diag_held = 0.f;
+    diag_channels = 0;
+  }
+
+  /**
+   * Measures the bus power per channel and applies the gain computed at the
+   * end of the previous block, ramped linearly to avoid zipper noise.
+   */
+  void applyAgc(float sample_time) {
+    for (int c = 0; c < out_channels; c += 4) {
+      int b = c / 4;
+      agc_sum_sq[b] += voltages[b] * voltages[b];
+      voltages[b] *= agc_gain[b];
+      agc_gain[b] += agc_gain_step[b];
+    }
+
+    if (++agc_frame >= AGC_BLOCK) {
+      agc_frame = 0;
+      updateAgcGain(sample_time);
+    }
+  }
+
+  /**
+   * Block-rate update: smooths the measured power, derives the gain needed to
+   * hit the target RMS in the log domain, caps it and smooths it there too.
+   */
+  void updateAgcGain(float sample_time) {
+    float block_time = AGC_BLOCK * sample_time;
+    float lambda = 1.f - std::exp(-block_time / AGC_TIMES[agc_speed]);
+    float target_log = std::log(AGC_TARGETS[agc_target]);
+    float max_log =
+        std::log(dsp::dbToAmplitude(AGC_MAX_GAINS_DB[agc_max_gain]));
+    float_4 inv_block = 1.f / AGC_BLOCK;
+
+    for (int b = 0; b < 4; ++b) {
+      agc_power[b] += (agc_sum_sq[b] * inv_block - agc_power[b]) * lambda;
+      agc_sum_sq[b] = 0.f;
+
+      float_4 wanted_log =
+          target_log - 0.5f * simd::log(agc_power[b] + 1e-9f);
+      wanted_log = simd::fmin(wanted_log, max_log);
+      agc_log_gain[b] += (wanted_log - agc_log_gain[b]) * lambda;
+
+      agc_gain_step[b] =
+          (simd::exp(agc_log_gain[b]) - agc_gain[b]) * inv_block;
+    }
+  }
+
+  void resetAgc() {
+    float target = AGC_TARGETS[agc_target];
+    agc_frame = 0;
+    for (int b = 0; b < 4; ++b) {
+      agc_sum_sq[b] = 0.f;
+      agc_power[b] = target * target;
+      agc_log_gain[b] = 0.f;
+      agc_gain[b] = 1.f;
+      agc_gain_step[b] = 0.f;
+    }
+  }
+
+  void setAgc(bool on) {
+    if (on && !agc_on) {
+      resetAgc();
     }
+    agc_on = on;
   }
 
+  void applyConvolution() {
+    // A new IR waits until the worker has freed the one retired before, so
+    // the single retired slot is never overwritten.
+    if (ir_pending.load(std::memory_order_relaxed) &&
+        !ir_retired.load(std::memory_order_acquire)) {
+      Convolver* next = ir_pending.exchange(nullptr);
+      if (next) {
+        ir_retired.store(ir_active);
+        ir_active = next;
+      }
+    }
+    if (ir_active && !ir_active->empty()) {
+      ir_active->process(voltages, out_channels);
+    }
+  }
+
+  /**
+   * Asks the worker thread to load an IR; an empty path unloads it. Returns
+   * at once. A request made while a load is running replaces any request
+   * still waiting, so only the latest one is loaded after it.
+   */
+  void loadImpulse(const std::string& path, float sample_rate) {
+    {
+      std::lock_guard<std::mutex> lock(ir_mutex);
+      ir_path = path;
+      ir_rate = sample_rate;
+      ir_requested = true;
+      if (!ir_loader.joinable()) {
+        ir_loader = std::thread([this]() { runImpulseLoader(); });
+      }
+    }
+    ir_wake.notify_one();
+  }
+
+  // The IR path for the menu and patch, which run on other threads.
+  std::string irPath() {
+    std::lock_guard<std::mutex> lock(ir_mutex);
+    return ir_path;
+  }
+
+  // Body of the IR worker, which lives until the module is destroyed.
+  void runImpulseLoader() {
+    std::unique_lock<std::mutex> lock(ir_mutex);
+    while (true) {
+      // The audio thread cannot wake the worker, so it also looks for a
+      // retired IR to free every IR_RECLAIM_POLL.
+      ir_wake.wait_for(lock, IR_RECLAIM_POLL,
+                       [this]() { return ir_requested || ir_stop; });
+      delete ir_retired.exchange(nullptr);
+      if (ir_stop) return;
+      if (!ir_requested) continue;
+      std::string path = ir_path;
+      float sample_rate = ir_rate;
+      ir_requested = false;
+      lock.unlock();
+
+      std::string error;
+      Convolver* convolver = path.empty()
+                                 ? new Convolver(nullptr, 0)
+                                 : Convolver::load(path, sample_rate, &error);
+      ir_failed = !convolver;
+      if (convolver) {
+        // A load the audio thread never picked up is simply dropped.
+        delete ir_pending.exchange(convolver);
+      }
+
+      lock.lock();
+    }
+  }
+
+  /**
+   * Splits the final bus into the LOW/MID/HIGH outputs. Skipped entirely
+   * while none of them is patched.
+   */
+  void applyCrossover(float sample_rate) {
+    Output& low_output = outputs[LOW_OUTPUT];
+    Output& mid_output = outputs[MID_OUTPUT];
+    Output& high_output = outputs[HIGH_OUTPUT];
+    if (!low_output.isConnected() && !mid_output.isConnected() &&
+        !high_output.isConnected()) {
+      return;
+    }
+
+    int key = xover_low * 16 + xover_high;
+    if (key != xover_key || sample_rate != xover_rate) {
+      xover_key = key;
+      xover_rate = sample_rate;
+      updateCrossoverCoefs();
+    }
+
+    low_output.setChannels(out_channels);
+    mid_output.setChannels(out_channels);
+    high_output.setChannels(out_channels);
+    for (int c = 0; c < out_channels; c += 4) {
+      CrossoverState& s = xover[c / 4];
+      float_4 x = voltages[c / 4];
+
+      float_4 low = s.low[0].process(xover_low_lp, x);
+      low = s.low[1].process(xover_low_lp, low);
+      low = s.low_allpass.process(xover_high_ap, low);
+
+      float_4 upper = s.upper[0].process(xover_low_hp, x);
+      upper = s.upper[1].process(xover_low_hp, upper);
+
+      float_4 mid = s.mid[0].process(xover_high_lp, upper);
+      mid = s.mid[1].process(xover_high_lp, mid);
+
+      float_4 high = s.high[0].process(xover_high_hp, upper);
+      high = s.high[1].process(xover_high_hp, high);
+
+      low_output.setVoltageSimd(low, c);
+      mid_output.setVoltageSimd(mid, c);
+      high_output.setVoltageSimd(high, c);
+    }
+  }
+
+  void updateCrossoverCoefs() {
+    float low = XOVER_LOW_FREQS[xover_low];
+    float high = XOVER_HIGH_FREQS[xover_high];
+    butterworth(low, &xover_low_lp, &xover_low_hp);
+    butterworth(high, &xover_high_lp, &xover_high_hp);
+
+    // The sum of an LR4 low/high pair is the second order allpass with the
+    // same poles, so it shares their denominator.
+    xover_high_ap.b0 = xover_high_lp.a2;
+    xover_high_ap.b1 = xover_high_lp.a1;
+    xover_high_ap.b2 = 1.f;
+    xover_high_ap.a1 = xover_high_lp.a1;
+    xover_high_ap.a2 = xover_high_lp.a2;
+  }
+
+  /**
+   * Bilinear-transform Butterworth low and high pass sections at freq.
+   */
+  void butterworth(float freq, BiquadCoefs* lp, BiquadCoefs* hp) {
+    freq = std::min(freq, 0.45f * xover_rate);
+    float k = std::tan(float(M_PI) * freq / xover_rate);
+    float k_q = k * float(M_SQRT2);
+    float norm = 1.f / (1.f + k_q + k * k);
+
+    lp->b0 = k * k * norm;
+    lp->b1 = 2.f * lp->b0;
+    lp->b2 = lp->b0;
+    lp->a1 = 2.f * (k * k - 1.f) * norm;
+    lp->a2 = (1.f - k_q + k * k) * norm;
+
+    hp->b0 = norm;
+    hp->b1 = -2.f * norm;
+    hp->b2 = norm;
+    hp->a1 = lp->a1;
+    hp->a2 = lp->a2;
+  }
+
+  /**
+   * Pans the poly channels evenly from left to right, scaled by the width,
+   * and mixes them down to the L/R outputs.
+   */
+  void applySpread() {
+    Output& left = outputs[LEFT_OUTPUT];
+    Output& right = outputs[RIGHT_OUTPUT];
+    if (!left.isConnected() && !right.isConnected()) return;
+
+    float width = params[WIDTH_PARAM].getValue();
+    if (out_channels != spread_channels || width != spread_width) {
+      spread_channels = out_channels;
+      spread_width = width;
+      updateSpreadGains();
+    }
+
+    float_4 sum_left = 0.f;
+    float_4 sum_right = 0.f;
+    for (int c = 0; c < out_channels; c += 4) {
+      sum_left += voltages[c / 4] * spread_left[c / 4];
+      sum_right += voltages[c / 4] * spread_right[c / 4];
+    }
+    // One pair of horizontal adds reduces both sums at once.
+    __m128 sums = _mm_hadd_ps(sum_left.v, sum_right.v);
+    float_4 total = float_4(_mm_hadd_ps(sums, sums));
+
+    left.setVoltage(total[0]);
+    right.setVoltage(total[1]);
+  }
+
+  /**
+   * Equal-power pan gains. Lanes past the last channel get zero gain so
+   * stale values there never reach the mix.
+   */
+  void updateSpreadGains() {
+    for (int c = 0; c < 16; ++c) {
+      float pan = 0.f;
+      if (spread_channels > 1) {
+        pan = (2.f * c / (spread_channels - 1) - 1.f) * spread_width;
+      }
+      float angle = (pan + 1.f) * float(M_PI) / 4.f;
+      bool active = c < spread_channels;
+      spread_left[c / 4][c % 4] = active ? std::cos(angle) : 0.f;
+      spread_right[c / 4][c % 4] = active ? std::sin(angle) : 0.f;
+    }
+  }
+
+  /**
+   * Writes the bus to the main output. A patched VCA input scales each
+   * channel by its own CV, or all of them by a mono CV, on the way out;
+   * 10 V is unity gain. Diagnostics can send the difference from the scalar
+   * reference there instead.
+   */
   void sendOutput() {
-    outputs[OUT_1_OUTPUT].setChannels(1);
-    outputs[OUT_1_OUTPUT].writeVoltages(voltages.data());
+    Output& output = outputs[OUT_1_OUTPUT];
+    if (diag_on && diag_null) {
+      output.setChannels(diag_channels);
+      for (int c = 0; c < diag_channels; ++c) {
+        output.setVoltage(diag_error[c], c);
+      }
+      return;
+    }
+    int channels = legacy_bus ? 1 : out_channels;
+    output.setChannels(channels);
+    Input& vca = inputs[VCA_INPUT];
+    if (!vca.isConnected()) {
+      for (int c = 0; c < channels; c += 4) {
+        output.setVoltageSimd(voltages[c / 4], c);
+      }
+      return;
+    }
+    for (int c = 0; c < channels; c += 4) {
+      float_4 gain =
+          simd::clamp(vca.getPolyVoltageSimd<float_4>(c) * 0.1f, 0.f, 1.f);
+      output.setVoltageSimd(voltages[c / 4] * gain, c);
+    }
+  }
+
+  void recordOutput() {
+    Output& output = outputs[OUT_1_OUTPUT];
+    int channels = output.getChannels();
+    float_4 frame[4];
+    for (int c = 0; c < channels; c += 4) {
+      frame[c / 4] = output.getVoltageSimd<float_4>(c);
+    }
+    recorder.push(frame, channels);
   }
 
   void disableOutput() {
+    last_layout = -1;
     outputs[OUT_1_OUTPUT].setChannels(0);
+    outputs[LOW_OUTPUT].setChannels(0);
+    outputs[MID_OUTPUT].setChannels(0);
+    outputs[HIGH_OUTPUT].setChannels(0);
+    outputs[LEFT_OUTPUT].setChannels(0);
+    outputs[RIGHT_OUTPUT].setChannels(0);
+    freeze_state = FREEZE_LIVE;
+    lights[FREEZE_LIGHT_LIGHT].setBrightness(0.0f);
     state_on_sum = false;
     state_on_avg = false;
     lights[SUM_LIGHT_LIGHT].setBrightness(0.0f);
     lights[AVG_LIGHT_LIGHT].setBrightness(0.0f);
   }
+
+  json_t* dataToJson() override {
+    json_t* rootJ = json_object();
+    json_object_set_new(rootJ, "power", json_boolean(state_on));
+    json_object_set_new(rootJ, "sum", json_boolean(state_on_sum));
+    json_object_set_new(rootJ, "avg", json_boolean(state_on_avg));
+    json_object_set_new(rootJ, "agc", json_boolean(agc_on));
+    json_object_set_new(rootJ, "agcTarget", json_integer(agc_target));
+    json_object_set_new(rootJ, "agcMaxGain", json_integer(agc_max_gain));
+    json_object_set_new(rootJ, "agcSpeed", json_integer(agc_speed));
+    json_object_set_new(rootJ, "freezeLength", json_integer(freeze_length));
+    json_object_set_new(rootJ, "collapse", json_integer(collapse));
+    json_object_set_new(rootJ, "console", json_integer(console));
+    json_object_set_new(rootJ, "quantize", json_integer(quantize));
+    json_object_set_new(rootJ, "group", json_boolean(group_on));
+    json_object_set_new(rootJ, "xoverLow", json_integer(xover_low));
+    json_object_set_new(rootJ, "xoverHigh", json_integer(xover_high));
+    json_object_set_new(rootJ, "irPath", json_string(irPath().c_str()));
+    json_object_set_new(rootJ, "legacyBus", json_boolean(legacy_bus));
+    return rootJ;
+  }
+
+  void fromJson(json_t* rootJ) override {
+    // The first release saved no module data; dataFromJson is only called
+    // when there is some.
+    legacy_bus = !json_object_get(rootJ, "data");
+    Module::fromJson(rootJ);
+  }
+
+  void dataFromJson(json_t* rootJ) override {
+    json_t* legacyBusJ = json_object_get(rootJ, "legacyBus");
+    if (legacyBusJ) {
+      legacy_bus = json_boolean_value(legacyBusJ);
+    }
+    json_t* powerJ = json_object_get(rootJ, "power");
+    if (powerJ) {
+      state_on = json_boolean_value(powerJ);
+    }
+    json_t* sumJ = json_object_get(rootJ, "sum");
+    json_t* avgJ = json_object_get(rootJ, "avg");
+    if (sumJ && avgJ) {
+      state_on_sum = json_boolean_value(sumJ);
+      state_on_avg = json_boolean_value(avgJ) && !state_on_sum;
+    }
+    json_t* agcTargetJ = json_object_get(rootJ, "agcTarget");
+    if (agcTargetJ) {
+      agc_target = clamp((int)json_integer_value(agcTargetJ), 0, 3);
+    }
+    json_t* agcMaxGainJ = json_object_get(rootJ, "agcMaxGain");
+    if (agcMaxGainJ) {
+      agc_max_gain = clamp((int)json_integer_value(agcMaxGainJ), 0, 2);
+    }
+    json_t* agcSpeedJ = json_object_get(rootJ, "agcSpeed");
+    if (agcSpeedJ) {
+      agc_speed = clamp((int)json_integer_value(agcSpeedJ), 0, 2);
+    }
+    json_t* freezeLengthJ = json_object_get(rootJ, "freezeLength");
+    if (freezeLengthJ) {
+      freeze_length = clamp((int)json_integer_value(freezeLengthJ), 0, 5);
+    }
+    json_t* collapseJ = json_object_get(rootJ, "collapse");
+    if (collapseJ) {
+      collapse = clamp((int)json_integer_value(collapseJ), 0, 3);
+    }
+    json_t* consoleJ = json_object_get(rootJ, "console");
+    if (consoleJ) {
+      console = clamp((int)json_integer_value(consoleJ), 0, 3);
+    }
+    json_t* quantizeJ = json_object_get(rootJ, "quantize");
+    if (quantizeJ) {
+      quantize = clamp((int)json_integer_value(quantizeJ), 0, 5);
+    }
+    json_t* groupJ = json_object_get(rootJ, "group");
+    if (groupJ) {
+      group_on = json_boolean_value(groupJ);
+    }
+    json_t* xoverLowJ = json_object_get(rootJ, "xoverLow");
+    if (xoverLowJ) {
+      xover_low = clamp((int)json_integer_value(xoverLowJ), 0, 2);
+    }
+    json_t* xoverHighJ = json_object_get(rootJ, "xoverHigh");
+    if (xoverHighJ) {
+      xover_high = clamp((int)json_integer_value(xoverHighJ), 0, 2);
+    }
+    json_t* irPathJ = json_object_get(rootJ, "irPath");
+    if (irPathJ && json_string_length(irPathJ) > 0) {
+      loadImpulse(json_string_value(irPathJ),
+                  APP->engine->getSampleRate());
+    }
+    json_t* agcJ = json_object_get(rootJ, "agc");
+    if (agcJ) {
+      setAgc(json_boolean_value(agcJ));
+    }
+  }
 };
 
 struct PassWidget : ModuleWidget {
@@ -162,6 +1661,14 @@ struct PassWidget : ModuleWidget {
         createParamCentered<VCVButton>(Vec(17, 91.5), module, Pass::SUM_PARAM));
     addParam(createParamCentered<VCVButton>(Vec(17, 130.5), module,
                                             Pass::AVG_PARAM));
+    addParam(createParamCentered<VCVButton>(Vec(62, 52.5), module,
+                                            Pass::FREEZE_PARAM));
+    addParam(createParamCentered<Trimpot>(Vec(113, 52.5), module,
+                                          Pass::WIDTH_PARAM));
+    addParam(createParamCentered<Trimpot>(Vec(62, 91.5), module,
+                                          Pass::ATTACK_PARAM));
+    addParam(createParamCentered<Trimpot>(Vec(62, 130.5), module,
+                                          Pass::SUSTAIN_PARAM));
 
     addInput(createInputCentered<PJ301MPort>(Vec(23, 188.5), module,
                                              Pass::IN_1_INPUT));
@@ -169,9 +1676,27 @@ struct PassWidget : ModuleWidget {
                                              Pass::IN_2_INPUT));
     addInput(createInputCentered<PJ301MPort>(Vec(23, 296.5), module,
                                              Pass::IN_3_INPUT));
+    addInput(createInputCentered<PJ301MPort>(Vec(68, 188.5), module,
+                                             Pass::CLOCK_INPUT));
+    addInput(createInputCentered<PJ301MPort>(Vec(68, 242.5), module,
+                                             Pass::GATE_INPUT));
+    addInput(createInputCentered<PJ301MPort>(Vec(158, 188.5), module,
+                                             Pass::VCA_INPUT));
+    addInput(createInputCentered<PJ301MPort>(Vec(158, 242.5), module,
+                                             Pass::WEIGHT_INPUT));
 
     addOutput(createOutputCentered<PJ301MPort>(Vec(23, 350), module,
                                                Pass::OUT_1_OUTPUT));
+    addOutput(createOutputCentered<PJ301MPort>(Vec(113, 188.5), module,
+                                               Pass::LOW_OUTPUT));
+    addOutput(createOutputCentered<PJ301MPort>(Vec(113, 242.5), module,
+                                               Pass::MID_OUTPUT));
+    addOutput(createOutputCentered<PJ301MPort>(Vec(113, 296.5), module,
+                                               Pass::HIGH_OUTPUT));
+    addOutput(createOutputCentered<PJ301MPort>(Vec(68, 350), module,
+                                               Pass::LEFT_OUTPUT));
+    addOutput(createOutputCentered<PJ301MPort>(Vec(113, 350), module,
+                                               Pass::RIGHT_OUTPUT));
 
     addChild(createLightCentered<MediumLight<RedLight>>(
         Vec(37.5, 52.5), module, Pass::POWER_LIGHT_LIGHT));
@@ -179,6 +1704,135 @@ struct PassWidget : ModuleWidget {
                                                         Pass::SUM_LIGHT_LIGHT));
     addChild(createLightCentered<MediumLight<RedLight>>(
         Vec(37.5, 130.5), module, Pass::AVG_LIGHT_LIGHT));
+    addChild(createLightCentered<MediumLight<RedLight>>(
+        Vec(82.5, 52.5), module, Pass::FREEZE_LIGHT_LIGHT));
+  }
+
+  void appendContextMenu(Menu* menu) override {
+    Pass* module = getModule<Pass>();
+
+    menu->addChild(new MenuSeparator);
+    menu->addChild(createMenuLabel("Automatic gain control"));
+    menu->addChild(createBoolMenuItem(
+        "AGC", "", [=]() { return module->agc_on; },
+        [=](bool on) { module->setAgc(on); }));
+    menu->addChild(createIndexPtrSubmenuItem(
+        "Target RMS", {"1 V", "2 V", "3.5 V", "5 V"}, &module->agc_target));
+    menu->addChild(createIndexPtrSubmenuItem(
+        "Max gain", {"+6 dB", "+12 dB", "+24 dB"}, &module->agc_max_gain));
+    menu->addChild(createIndexPtrSubmenuItem(
+        "Response", {"Fast", "Medium", "Slow"}, &module->agc_speed));
+
+    menu->addChild(new MenuSeparator);
+    menu->addChild(createIndexPtrSubmenuItem(
+        "Freeze length", {"1 cycle", "2 cycles", "4 cycles", "8 cycles",
+                          "16 cycles", "32 cycles"},
+        &module->freeze_length));
+    menu->addChild(createMenuLabel(module->freezeStatus()));
+    menu->addChild(createIndexPtrSubmenuItem(
+        "Voice collapse",
+        {"Off", "Pairs (16 to 8)", "Groups of 4 (16 to 4)",
+         "Groups of 8 (16 to 2)"},
+        &module->collapse));
+    menu->addChild(createIndexPtrSubmenuItem(
+        "Console drive", {"Off", "Light", "Medium", "Heavy"},
+        &module->console));
+    menu->addChild(createIndexPtrSubmenuItem(
+        "Quantize buttons to clock",
+        {"Off", "Every clock", "Every 2 clocks", "Every 4 clocks",
+         "Every 8 clocks", "Every 16 clocks"},
+        &module->quantize));
+
+    menu->addChild(createBoolPtrMenuItem(
+        "Group with neighbours", "2 samples latency", &module->group_on));
+    menu->addChild(createBoolPtrMenuItem("Legacy bus (first release)", "",
+                                         &module->legacy_bus));
+
+    menu->addChild(new MenuSeparator);
+    menu->addChild(createMenuLabel("Band outputs"));
+    menu->addChild(createIndexPtrSubmenuItem(
+        "Low/mid split", {"100 Hz", "200 Hz", "400 Hz"}, &module->xover_low));
+    menu->addChild(createIndexPtrSubmenuItem("Mid/high split",
+                                             {"1.5 kHz", "3 kHz", "6 kHz"},
+                                             &module->xover_high));
+
+    menu->addChild(new MenuSeparator);
+    menu->addChild(createMenuLabel("Impulse response"));
+    std::string ir_path = module->irPath();
+    std::string ir_name =
+        ir_path.empty() ? "None" : system::getFilename(ir_path);
+    if (module->ir_failed) {
+      ir_name += " (failed to load)";
+    }
+    menu->addChild(createMenuLabel(ir_name));
+    menu->addChild(createMenuItem("Load IR...", "", [=]() {
+      std::string dir = ir_path.empty() ? "" : system::getDirectory(ir_path);
+      osdialog_filters* filters = osdialog_filters_parse("WAV:wav");
+      char* pathC = osdialog_file(OSDIALOG_OPEN, dir.c_str(), NULL, filters);
+      osdialog_filters_free(filters);
+      if (!pathC) return;
+      module->loadImpulse(pathC, APP->engine->getSampleRate());
+      std::free(pathC);
+    }));
+    menu->addChild(createMenuItem(
+        "Unload IR", "",
+        [=]() { module->loadImpulse("", APP->engine->getSampleRate()); },
+        ir_path.empty()));
+
+    menu->addChild(new MenuSeparator);
+    menu->addChild(createMenuLabel("Recording"));
+    // The last take stays listed while it has clipped, so it can be redone.
+    std::string take = "Not recording";
+    int64_t clipped = module->recorder.clipped;
+    if (module->recorder.active() || module->recorder.failed || clipped > 0) {
+      take = system::getFilename(module->recorder.path);
+      int64_t dropped = module->recorder.dropped;
+      if (module->recorder.active() && dropped > 0) {
+        take += string::f(" (%lld frames dropped)", (long long)dropped);
+      }
+      if (clipped > 0) {
+        take += string::f(" (%lld samples clipped at 10 V)",
+                          (long long)clipped);
+      }
+      if (module->recorder.failed) {
+        take += " (failed)";
+      }
+    }
+    menu->addChild(createMenuLabel(take));
+    menu->addChild(createMenuItem(
+        "Record to FLAC...", "",
+        [=]() {
+          osdialog_filters* filters = osdialog_filters_parse("FLAC:flac");
+          char* pathC =
+              osdialog_file(OSDIALOG_SAVE, NULL, "Pass.flac", filters);
+          osdialog_filters_free(filters);
+          if (!pathC) return;
+          std::string path = pathC;
+          std::free(pathC);
+          if (system::getExtension(path) != ".flac") {
+            path += ".flac";
+          }
+          module->recorder.start(path, (int)APP->engine->getSampleRate());
+        },
+        module->recorder.active()));
+    menu->addChild(createMenuItem(
+        "Stop recording", "", [=]() { module->recorder.stop(); },
+        !module->recorder.active()));
+
+    menu->addChild(new MenuSeparator);
+    menu->addChild(createSubmenuItem("Diagnostics", "", [=](Menu* menu) {
+      menu->addChild(createBoolMenuItem(
+          "Compare with scalar reference", "",
+          [=]() { return module->diag_on; },
+          [=](bool on) { module->setDiagnostics(on); }));
+      menu->addChild(createBoolPtrMenuItem("Send difference to OUT", "",
+                                           &module->diag_null));
+      menu->addChild(createMenuLabel(
+          string::f("Max error: %.3g V", module->diag_max_error)));
+      menu->addChild(createMenuItem("Reset max error", "", [=]() {
+        module->diag_max_error = 0.f;
+      }));
+    }));
   }
 };
 
@@ -0,0 +1,148 @@
+/**
+ * @file PassEngine.hpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Rack-independent SUM/AVG core of Pass, for offline rendering.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+#include <algorithm>
+
+/**
+ * Channels carried by one sample of type T and the scalar type of each: 1
+ * and T itself for float and double. SIMD vector types specialize this, e.g.
+ * 4 floats for Rack's float_4.
+ */
+template <typename T>
+struct SampleLanes {
+  static const int value = 1;
+  typedef T scalar;
+};
+
+/**
+ * Processes blocks of planar audio the way Pass processes single frames:
+ * every input channel c is summed into output channel c, and AVG divides
+ * output channel c by the number of inputs that carry it.
+ *
+ * The sample type T is also the accumulator, so the same code runs the live
+ * module on float_4 and offline renders on float or double. Buffers are
+ * planar with a fixed stride: row r of a buffer starts at `buffer + r *
+ * stride` and holds channel r, or channels r * LANES onwards for vector
+ * types.
+ */
+template <typename T>
+struct TPassEngine {
+  static const int MAX_INPUTS = 3;
+  static const int MAX_CHANNELS = 16;
+  static const int LANES = SampleLanes<T>::value;
+
+  bool average = false;
+
+  /**
+   * Frames of history a copy of the engine needs before its output matches a
+   * serial render, used as pre-roll when a file is rendered in segments.
+   * SUM and AVG are stateless per frame; stateful stages add to this.
+   */
+  int warmupFrames() const { return 0; }
+
+  static int outputChannels(const int* channels) {
+    int out_channels = 0;
+    for (int i = 0; i < MAX_INPUTS; ++i) {
+      out_channels = std::max(out_channels, channels[i]);
+    }
+    return out_channels;
+  }
+
+  /** Rows needed for `channels` channels. */
+  static int rows(int channels) { return (channels + LANES - 1) / LANES; }
+
+  static void accumulate(T* out, const T* in, int n) {
+    for (int k = 0; k < n; ++k) {
+      out[k] += in[k];
+    }
+  }
+
+  static void scale(T* out, T factor, int n) {
+    for (int k = 0; k < n; ++k) {
+      out[k] *= factor;
+    }
+  }
+
+  /**
+   * AVG factor of every output row: per channel the reciprocal of the number
+   * of inputs carrying it, 0 for channels no input carries.
+   *
+   * @param channels Channel count of each input, 0 for unpatched inputs.
+   * @param factors MAX_CHANNELS / LANES rows.
+   */
+  static void averageFactors(const int* channels, T* factors) {
+    typedef typename SampleLanes<T>::scalar Scalar;
+    Scalar* lanes = reinterpret_cast<Scalar*>(factors);
+    for (int c = 0; c < MAX_CHANNELS; ++c) {
+      int count = 0;
+      for (int i = 0; i < MAX_INPUTS; ++i) {
+        count += c < channels[i];
+      }
+      lanes[c] = count > 0 ? Scalar(1) / Scalar(count) : Scalar(0);
+    }
+  }
+
+  /**
+   * Gated AVG factors: weighting the bus by them and adding up all channels
+   * gives the mean of the voices whose gate is high, each voice being its
+   * channel averaged over the inputs carrying it. Released voices get 0.
+   *
+   * @param channels Channel count of each input, 0 for unpatched inputs.
+   * @param gates Bit c set while the gate of voice c is high.
+   * @param factors MAX_CHANNELS / LANES rows.
+   * @return The number of gated voices the bus carries.
+   */
+  static int gatedFactors(const int* channels, int gates, T* factors) {
+    typedef typename SampleLanes<T>::scalar Scalar;
+    averageFactors(channels, factors);
+    Scalar* lanes = reinterpret_cast<Scalar*>(factors);
+    int voices = 0;
+    for (int c = 0; c < MAX_CHANNELS; ++c) {
+      if (!(gates & (1 << c)) || lanes[c] == Scalar(0)) {
+        lanes[c] = Scalar(0);
+      } else {
+        ++voices;
+      }
+    }
+    for (int c = 0; c < MAX_CHANNELS && voices > 0; ++c) {
+      lanes[c] /= Scalar(voices);
+    }
+    return voices;
+  }
+
+  /**
+   * @param in MAX_INPUTS planar buffers, null for unpatched inputs.
+   * @param channels Channel count of each input, 0 for unpatched inputs.
+   */
+  void process(const T* const* in, const int* channels, T* out, int stride,
+               int frames) const {
+    int out_rows = rows(outputChannels(channels));
+
+    std::fill(out, out + out_rows * stride, T(0));
+    for (int i = 0; i < MAX_INPUTS; ++i) {
+      if (!in[i]) continue;
+      for (int r = 0; r < rows(channels[i]); ++r) {
+        accumulate(out + r * stride, in[i] + r * stride, frames);
+      }
+    }
+
+    if (average) {
+      T factors[MAX_CHANNELS / LANES];
+      averageFactors(channels, factors);
+      for (int r = 0; r < out_rows; ++r) {
+        scale(out + r * stride, factors[r], frames);
+      }
+    }
+  }
+};
+
+typedef TPassEngine<float> PassEngine;
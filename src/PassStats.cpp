@@ -0,0 +1,182 @@
+/**
+ * @file PassStats.cpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Model definition of Pass Stats, a Pass with SUM, AVG, MIN and MAX
+ * outputs, for VCV Rack 2.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "BusEngine.hpp"
+#include "plugin.hpp"
+
+using simd::float_4;
+
+struct PassStats : Module {
+  enum ParamId { POWER_PARAM, PARAMS_LEN };
+  enum InputId { IN_1_INPUT, IN_2_INPUT, IN_3_INPUT, INPUTS_LEN };
+  enum OutputId {
+    SUM_OUTPUT,
+    AVG_OUTPUT,
+    MIN_OUTPUT,
+    MAX_OUTPUT,
+    OUTPUTS_LEN
+  };
+  enum LightId { POWER_LIGHT_LIGHT, LIGHTS_LEN };
+
+  bool state_on = false;
+  bool last_state = false;
+
+  int out_channels = 0;
+  int channels[3] = {};
+
+  // SUM and AVG come from the same core as Pass, so both modules report the
+  // same values. The AVG factors only change with the input layout.
+  int channel_layout = -1;
+  float_4 avg_factors[4] = {};
+
+  PassStats() {
+    config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+    configButton(PassStats::POWER_PARAM, "Power Trigger");
+
+    configInput(PassStats::IN_1_INPUT, "Track 1");
+    configInput(PassStats::IN_2_INPUT, "Track 2");
+    configInput(PassStats::IN_3_INPUT, "Track 3");
+
+    configOutput(PassStats::SUM_OUTPUT, "Sum");
+    configOutput(PassStats::AVG_OUTPUT, "Average");
+    configOutput(PassStats::MIN_OUTPUT, "Minimum");
+    configOutput(PassStats::MAX_OUTPUT, "Maximum");
+
+    configLight(PassStats::POWER_LIGHT_LIGHT, "Power Status");
+  }
+
+  void process(const ProcessArgs&) override {
+    updatePowerState();
+
+    if (!state_on) {
+      disableOutputs();
+      return;
+    }
+
+    updateLayout();
+    for (int o = 0; o < OUTPUTS_LEN; ++o) {
+      outputs[o].setChannels(out_channels);
+    }
+    processInputs();
+  }
+
+  void updatePowerState() {
+    bool current_state = params[POWER_PARAM].getValue() == 1;
+    if (current_state && !last_state) {
+      state_on = !state_on;
+    }
+    last_state = current_state;
+
+    lights[POWER_LIGHT_LIGHT].setBrightness(state_on ? 1.0f : 0.0f);
+  }
+
+  void updateLayout() {
+    int layout = 0;
+    for (int i = 0; i < 3; ++i) {
+      channels[i] = inputs[IN_1_INPUT + i].getChannels();
+      layout = (layout << 5) | channels[i];
+    }
+    out_channels = BusEngine::outputChannels(channels);
+    if (layout == channel_layout) return;
+    channel_layout = layout;
+    BusEngine::averageFactors(channels, avg_factors);
+  }
+
+  /**
+   * Computes all four outputs in one traversal: every input block is loaded
+   * once and feeds the sum, minimum and maximum together. Lanes an input
+   * does not carry are masked out so they never win MIN or MAX.
+   */
+  void processInputs() {
+    float_4 sum[4] = {};
+    float_4 low[4] = {INFINITY, INFINITY, INFINITY, INFINITY};
+    float_4 high[4] = {-INFINITY, -INFINITY, -INFINITY, -INFINITY};
+
+    for (int i = 0; i < 3; ++i) {
+      int rows = BusEngine::rows(channels[i]);
+      float_4 blocks[4];
+      for (int b = 0; b < rows; ++b) {
+        blocks[b] = inputs[IN_1_INPUT + i].getVoltageSimd<float_4>(b * 4);
+        float_4 lane = float_4(0.f, 1.f, 2.f, 3.f) + 4.f * b;
+        float_4 valid = lane < float_4(channels[i]);
+        low[b] = simd::ifelse(valid, simd::fmin(low[b], blocks[b]), low[b]);
+        high[b] = simd::ifelse(valid, simd::fmax(high[b], blocks[b]), high[b]);
+      }
+      BusEngine::accumulate(sum, blocks, rows);
+    }
+
+    for (int c = 0; c < out_channels; c += 4) {
+      // Lanes past the last channel have no contributor at all.
+      float_4 used = avg_factors[c / 4] > 0.f;
+      outputs[SUM_OUTPUT].setVoltageSimd(sum[c / 4], c);
+      outputs[AVG_OUTPUT].setVoltageSimd(sum[c / 4] * avg_factors[c / 4], c);
+      outputs[MIN_OUTPUT].setVoltageSimd(
+          simd::ifelse(used, low[c / 4], 0.f), c);
+      outputs[MAX_OUTPUT].setVoltageSimd(
+          simd::ifelse(used, high[c / 4], 0.f), c);
+    }
+  }
+
+  void disableOutputs() {
+    for (int o = 0; o < OUTPUTS_LEN; ++o) {
+      outputs[o].setChannels(0);
+    }
+  }
+
+  json_t* dataToJson() override {
+    json_t* rootJ = json_object();
+    json_object_set_new(rootJ, "power", json_boolean(state_on));
+    return rootJ;
+  }
+
+  void dataFromJson(json_t* rootJ) override {
+    json_t* powerJ = json_object_get(rootJ, "power");
+    if (powerJ) {
+      state_on = json_boolean_value(powerJ);
+    }
+  }
+};
+
+struct PassStatsWidget : ModuleWidget {
+  PassStatsWidget(PassStats* module) {
+    setModule(module);
+    setPanel(
+        createPanel(asset::plugin(pluginInstance, "res/PassStats.svg")));
+
+    addChild(createWidget<ScrewSilver>(Vec(15, 0)));
+    addChild(createWidget<ScrewSilver>(Vec(15, 375)));
+
+    addParam(createParamCentered<VCVButton>(Vec(17, 52.5), module,
+                                            PassStats::POWER_PARAM));
+
+    addInput(createInputCentered<PJ301MPort>(Vec(23, 188.5), module,
+                                             PassStats::IN_1_INPUT));
+    addInput(createInputCentered<PJ301MPort>(Vec(23, 242.5), module,
+                                             PassStats::IN_2_INPUT));
+    addInput(createInputCentered<PJ301MPort>(Vec(23, 296.5), module,
+                                             PassStats::IN_3_INPUT));
+
+    addOutput(createOutputCentered<PJ301MPort>(Vec(68, 188.5), module,
+                                               PassStats::SUM_OUTPUT));
+    addOutput(createOutputCentered<PJ301MPort>(Vec(68, 242.5), module,
+                                               PassStats::AVG_OUTPUT));
+    addOutput(createOutputCentered<PJ301MPort>(Vec(68, 296.5), module,
+                                               PassStats::MIN_OUTPUT));
+    addOutput(createOutputCentered<PJ301MPort>(Vec(68, 350), module,
+                                               PassStats::MAX_OUTPUT));
+
+    addChild(createLightCentered<MediumLight<RedLight>>(
+        Vec(37.5, 52.5), module, PassStats::POWER_LIGHT_LIGHT));
+  }
+};
+
+Model* modelPassStats = createModel<PassStats, PassStatsWidget>("PassStats");
@@ -0,0 +1,431 @@
+/**
+ * @file PcmConvert.cpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Sample format conversion between WAV data and planar volts.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "PcmConvert.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#define PCM_SSE 1
+#endif
+
+// Integer full scales, and the float limits that still convert without
+// overflowing the destination type. Decoding multiplies by the volts of one
+// step and encoding divides by the same float, which undoes the rounding of
+// the multiply exactly, so integer data passes through bit for bit.
+static const float PCM16_SCALE = 32768.f;
+static const float PCM16_MIN = -32768.f;
+static const float PCM16_MAX = 32767.f;
+static const float PCM24_SCALE = 8388608.f;
+static const float PCM24_MIN = -8388608.f;
+static const float PCM24_MAX = 8388607.f;
+static const float PCM32_SCALE = 2147483648.f;
+static const float PCM32_MIN = -2147483648.f;
+static const float PCM32_MAX = 2147483520.f;
+
+// Integer hash with good avalanche (lowbias32), the dither noise source.
+static uint32_t hash32(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7feb352du;
+  x ^= x >> 15;
+  x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+// Uniform in [0, 1) from the top 23 bits.
+static float unitFloat(uint32_t x) {
+  uint32_t bits = (x >> 9) | 0x3f800000u;
+  float f;
+  std::memcpy(&f, &bits, 4);
+  return f - 1.f;
+}
+
+static float ditherScalar(const PcmDither* dither, size_t i) {
+  if (!dither || !dither->enabled) return 0.f;
+  uint32_t a = hash32((uint32_t)(dither->position + i));
+  uint32_t b = hash32(a);
+  return unitFloat(a) - unitFloat(b);
+}
+
+void pcmToFloatScalar(WavFormat format, const char* in, float* out,
+                      size_t count, float gain) {
+  switch (format) {
+    case WAV_INT16:
+      for (size_t i = 0; i < count; ++i) {
+        int16_t s;
+        std::memcpy(&s, in + 2 * i, 2);
+        out[i] = s * (gain / PCM16_SCALE);
+      }
+      break;
+    case WAV_INT24:
+      for (size_t i = 0; i < count; ++i) {
+        const char* p = in + 3 * i;
+        int32_t s =
+            (uint8_t)p[0] | ((uint8_t)p[1] << 8) | ((int8_t)p[2] << 16);
+        out[i] = s * (gain / PCM24_SCALE);
+      }
+      break;
+    case WAV_INT32:
+      for (size_t i = 0; i < count; ++i) {
+        int32_t s;
+        std::memcpy(&s, in + 4 * i, 4);
+        out[i] = s * (gain / PCM32_SCALE);
+      }
+      break;
+    default:
+      for (size_t i = 0; i < count; ++i) {
+        float s;
+        std::memcpy(&s, in + 4 * i, 4);
+        out[i] = s * gain;
+      }
+      break;
+  }
+}
+
+void floatToPcmScalar(WavFormat format, const float* in, char* out,
+                      size_t count, float volts, PcmDither* dither) {
+  for (size_t i = 0; i < count; ++i) {
+    if (format == WAV_INT16) {
+      float v = in[i] / (volts / PCM16_SCALE) + ditherScalar(dither, i);
+      v = std::min(std::max(v, PCM16_MIN), PCM16_MAX);
+      int16_t s = (int16_t)std::lrint(v);
+      std::memcpy(out + 2 * i, &s, 2);
+    } else if (format == WAV_INT24) {
+      float v = in[i] / (volts / PCM24_SCALE) + ditherScalar(dither, i);
+      v = std::min(std::max(v, PCM24_MIN), PCM24_MAX);
+      int32_t s = (int32_t)std::lrint(v);
+      char* p = out + 3 * i;
+      p[0] = (char)s;
+      p[1] = (char)(s >> 8);
+      p[2] = (char)(s >> 16);
+    } else if (format == WAV_INT32) {
+      float v = in[i] / (volts / PCM32_SCALE);
+      v = std::min(std::max(v, PCM32_MIN), PCM32_MAX);
+      int32_t s = (int32_t)std::lrint(v);
+      std::memcpy(out + 4 * i, &s, 4);
+    } else {
+      float v = in[i] / volts;
+      std::memcpy(out + 4 * i, &v, 4);
+    }
+  }
+  if (dither) {
+    dither->position += count;
+  }
+}
+
+void deinterleaveScalar(const float* in, int channels, int frames,
+                        float* planes, int stride) {
+  for (int c = 0; c < channels; ++c) {
+    float* plane = planes + c * stride;
+    for (int f = 0; f < frames; ++f) {
+      plane[f] = in[f * channels + c];
+    }
+  }
+}
+
+void interleaveScalar(const float* planes, int stride, int channels,
+                      int frames, float* out) {
+  for (int c = 0; c < channels; ++c) {
+    const float* plane = planes + c * stride;
+    for (int f = 0; f < frames; ++f) {
+      out[f * channels + c] = plane[f];
+    }
+  }
+}
+
+#if PCM_SSE
+
+void pcmToFloat(WavFormat format, const char* in, float* out, size_t count,
+                float gain) {
+  size_t i = 0;
+  switch (format) {
+    case WAV_INT16: {
+      __m128 scale = _mm_set1_ps(gain / PCM16_SCALE);
+      for (; i + 8 <= count; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(in + 2 * i));
+        // Interleaving a vector with itself and shifting back sign-extends.
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+      }
+      pcmToFloatScalar(format, in + 2 * i, out + i, count - i, gain);
+    } break;
+    case WAV_INT24: {
+      // Moves each 3-byte sample into the top of a 32-bit lane, then an
+      // arithmetic shift sign-extends it. The 16-byte load reads 4 bytes
+      // past the 4 samples, hence the extra margin on the loop bound.
+      __m128i shuffle =
+          _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+      __m128 scale = _mm_set1_ps(gain / PCM24_SCALE);
+      for (; i + 6 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(in + 3 * i));
+        s = _mm_srai_epi32(_mm_shuffle_epi8(s, shuffle), 8);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(s), scale));
+      }
+      pcmToFloatScalar(format, in + 3 * i, out + i, count - i, gain);
+    } break;
+    case WAV_INT32: {
+      __m128 scale = _mm_set1_ps(gain / PCM32_SCALE);
+      for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(in + 4 * i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(s), scale));
+      }
+      pcmToFloatScalar(format, in + 4 * i, out + i, count - i, gain);
+    } break;
+    default: {
+      __m128 scale = _mm_set1_ps(gain);
+      for (; i + 4 <= count; i += 4) {
+        __m128 s = _mm_loadu_ps((const float*)(in + 4 * i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(s, scale));
+      }
+      pcmToFloatScalar(format, in + 4 * i, out + i, count - i, gain);
+    } break;
+  }
+}
+
+// Low 32 bits of each lane times k, from two SSE2 64-bit multiplies.
+static __m128i mulloSse(__m128i x, uint32_t k) {
+  __m128i factor = _mm_set1_epi32((int)k);
+  __m128i even = _mm_mul_epu32(x, factor);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), factor);
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static __m128i hash32Sse(__m128i x) {
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+  x = mulloSse(x, 0x7feb352du);
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+  x = mulloSse(x, 0x846ca68bu);
+  x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+  return x;
+}
+
+static __m128 unitFloatSse(__m128i x) {
+  __m128i bits =
+      _mm_or_si128(_mm_srli_epi32(x, 9), _mm_set1_epi32(0x3f800000));
+  return _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.f));
+}
+
+/**
+ * Divides 4 samples by the volts of one step, dithers and clamps them to the
+ * integer range, then rounds to nearest like lrint() in the scalar path.
+ * `index` holds the sample indices of the 4 lanes and is advanced past them.
+ */
+static __m128i quantizeSse(const float* in, __m128 step, __m128 lo, __m128 hi,
+                           __m128i* index, bool dither) {
+  __m128 v = _mm_div_ps(_mm_loadu_ps(in), step);
+  if (dither) {
+    __m128i a = hash32Sse(*index);
+    __m128i b = hash32Sse(a);
+    v = _mm_add_ps(v, _mm_sub_ps(unitFloatSse(a), unitFloatSse(b)));
+    *index = _mm_add_epi32(*index, _mm_set1_epi32(4));
+  }
+  return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(v, lo), hi));
+}
+
+void floatToPcm(WavFormat format, const float* in, char* out, size_t count,
+                float volts, PcmDither* dither) {
+  bool dithered = dither && dither->enabled && format != WAV_INT32 &&
+                  format != WAV_FLOAT32;
+  __m128i index = _mm_setzero_si128();
+  if (dithered) {
+    index = _mm_add_epi32(_mm_set1_epi32((int)(uint32_t)dither->position),
+                          _mm_setr_epi32(0, 1, 2, 3));
+  }
+
+  size_t i = 0;
+  switch (format) {
+    case WAV_INT16: {
+      __m128 step = _mm_set1_ps(volts / PCM16_SCALE);
+      __m128 lo = _mm_set1_ps(PCM16_MIN);
+      __m128 hi = _mm_set1_ps(PCM16_MAX);
+      for (; i + 8 <= count; i += 8) {
+        __m128i a = quantizeSse(in + i, step, lo, hi, &index, dithered);
+        __m128i b = quantizeSse(in + i + 4, step, lo, hi, &index, dithered);
+        _mm_storeu_si128((__m128i*)(out + 2 * i), _mm_packs_epi32(a, b));
+      }
+    } break;
+    case WAV_INT24: {
+      // Keeps the low 3 bytes of each lane. The 16-byte store writes 4
+      // bytes past the 4 samples, which the next iteration overwrites.
+      __m128i shuffle =
+          _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+      __m128 step = _mm_set1_ps(volts / PCM24_SCALE);
+      __m128 lo = _mm_set1_ps(PCM24_MIN);
+      __m128 hi = _mm_set1_ps(PCM24_MAX);
+      for (; i + 6 <= count; i += 4) {
+        __m128i s = quantizeSse(in + i, step, lo, hi, &index, dithered);
+        _mm_storeu_si128((__m128i*)(out + 3 * i), _mm_shuffle_epi8(s, shuffle));
+      }
+    } break;
+    case WAV_INT32: {
+      __m128 step = _mm_set1_ps(volts / PCM32_SCALE);
+      __m128 lo = _mm_set1_ps(PCM32_MIN);
+      __m128 hi = _mm_set1_ps(PCM32_MAX);
+      for (; i + 4 <= count; i += 4) {
+        __m128i s = quantizeSse(in + i, step, lo, hi, &index, false);
+        _mm_storeu_si128((__m128i*)(out + 4 * i), s);
+      }
+    } break;
+    default: {
+      __m128 scale = _mm_set1_ps(volts);
+      for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps((float*)(out + 4 * i),
+                      _mm_div_ps(_mm_loadu_ps(in + i), scale));
+      }
+    } break;
+  }
+
+  if (dither) {
+    dither->position += i;
+  }
+  floatToPcmScalar(format, in + i, out + i * wavSampleBytes(format), count - i,
+                   volts, dither);
+}
+
+void deinterleave(const float* in, int channels, int frames, float* planes,
+                  int stride) {
+  int f = 0;
+  if (channels == 1) {
+    std::memcpy(planes, in, frames * sizeof(float));
+    return;
+  } else if (channels == 2) {
+    for (; f + 4 <= frames; f += 4) {
+      __m128 a = _mm_loadu_ps(in + 2 * f);
+      __m128 b = _mm_loadu_ps(in + 2 * f + 4);
+      _mm_storeu_ps(planes + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+      _mm_storeu_ps(planes + stride + f,
+                    _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+  } else if (channels == 3) {
+    // 4 frames are 3 vectors; each plane gathers a pair of lanes from each
+    // of two neighbouring vectors, then merges the pairs.
+    for (; f + 4 <= frames; f += 4) {
+      __m128 a = _mm_loadu_ps(in + 3 * f);
+      __m128 b = _mm_loadu_ps(in + 3 * f + 4);
+      __m128 c = _mm_loadu_ps(in + 3 * f + 8);
+      __m128 x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 0, 0)),
+                                _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)),
+                                _MM_SHUFFLE(2, 0, 2, 0));
+      __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                                _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+                                _MM_SHUFFLE(2, 0, 2, 0));
+      __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                                _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+                                _MM_SHUFFLE(2, 0, 2, 0));
+      _mm_storeu_ps(planes + f, x);
+      _mm_storeu_ps(planes + stride + f, y);
+      _mm_storeu_ps(planes + 2 * stride + f, z);
+    }
+  } else if (channels % 4 == 0) {
+    // Channel groups outermost, so each pass writes 4 planes sequentially.
+    int end = frames & ~3;
+    for (int c = 0; c < channels; c += 4) {
+      for (f = 0; f < end; f += 4) {
+        const float* p = in + f * channels + c;
+        __m128 r0 = _mm_loadu_ps(p);
+        __m128 r1 = _mm_loadu_ps(p + channels);
+        __m128 r2 = _mm_loadu_ps(p + 2 * channels);
+        __m128 r3 = _mm_loadu_ps(p + 3 * channels);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        _mm_storeu_ps(planes + c * stride + f, r0);
+        _mm_storeu_ps(planes + (c + 1) * stride + f, r1);
+        _mm_storeu_ps(planes + (c + 2) * stride + f, r2);
+        _mm_storeu_ps(planes + (c + 3) * stride + f, r3);
+      }
+    }
+  }
+  deinterleaveScalar(in + f * channels, channels, frames - f, planes + f,
+                     stride);
+}
+
+void interleave(const float* planes, int stride, int channels, int frames,
+                float* out) {
+  int f = 0;
+  if (channels == 1) {
+    std::memcpy(out, planes, frames * sizeof(float));
+    return;
+  } else if (channels == 2) {
+    for (; f + 4 <= frames; f += 4) {
+      __m128 l = _mm_loadu_ps(planes + f);
+      __m128 r = _mm_loadu_ps(planes + stride + f);
+      _mm_storeu_ps(out + 2 * f, _mm_unpacklo_ps(l, r));
+      _mm_storeu_ps(out + 2 * f + 4, _mm_unpackhi_ps(l, r));
+    }
+  } else if (channels == 3) {
+    // The inverse of the deinterleave gathers above.
+    for (; f + 4 <= frames; f += 4) {
+      __m128 x = _mm_loadu_ps(planes + f);
+      __m128 y = _mm_loadu_ps(planes + stride + f);
+      __m128 z = _mm_loadu_ps(planes + 2 * stride + f);
+      __m128 a = _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+                                _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)),
+                                _MM_SHUFFLE(2, 0, 2, 0));
+      __m128 b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+                                _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)),
+                                _MM_SHUFFLE(2, 0, 2, 0));
+      __m128 c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+                                _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)),
+                                _MM_SHUFFLE(2, 0, 2, 0));
+      _mm_storeu_ps(out + 3 * f, a);
+      _mm_storeu_ps(out + 3 * f + 4, b);
+      _mm_storeu_ps(out + 3 * f + 8, c);
+    }
+  } else if (channels % 4 == 0) {
+    int end = frames & ~3;
+    for (int c = 0; c < channels; c += 4) {
+      for (f = 0; f < end; f += 4) {
+        __m128 r0 = _mm_loadu_ps(planes + c * stride + f);
+        __m128 r1 = _mm_loadu_ps(planes + (c + 1) * stride + f);
+        __m128 r2 = _mm_loadu_ps(planes + (c + 2) * stride + f);
+        __m128 r3 = _mm_loadu_ps(planes + (c + 3) * stride + f);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        float* p = out + f * channels + c;
+        _mm_storeu_ps(p, r0);
+        _mm_storeu_ps(p + channels, r1);
+        _mm_storeu_ps(p + 2 * channels, r2);
+        _mm_storeu_ps(p + 3 * channels, r3);
+      }
+    }
+  }
+  interleaveScalar(planes + f, stride, channels, frames - f,
+                   out + f * channels);
+}
+
+#else
+
+void pcmToFloat(WavFormat format, const char* in, float* out, size_t count,
+                float gain) {
+  pcmToFloatScalar(format, in, out, count, gain);
+}
+
+void floatToPcm(WavFormat format, const float* in, char* out, size_t count,
+                float volts, PcmDither* dither) {
+  floatToPcmScalar(format, in, out, count, volts, dither);
+}
+
+void deinterleave(const float* in, int channels, int frames, float* planes,
+                  int stride) {
+  deinterleaveScalar(in, channels, frames, planes, stride);
+}
+
+void interleave(const float* planes, int stride, int channels, int frames,
+                float* out) {
+  interleaveScalar(planes, stride, channels, frames, out);
+}
+
+#endif
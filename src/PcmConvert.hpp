@@ -0,0 +1,58 @@
+/**
+ * @file PcmConvert.hpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Sample format conversion between WAV data and planar volts.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "Wav.hpp"
+
+/**
+ * TPDF dither of +-1 LSB for integer output. The noise of each sample is a
+ * hash of its index in the file, so it does not depend on how the file is
+ * split into writes or segments; it repeats every 2^32 samples.
+ */
+struct PcmDither {
+  bool enabled = false;
+  // Index of the next sample written, counted over all channels.
+  uint64_t position = 0;
+};
+
+/**
+ * Converts `count` interleaved file samples to floats, multiplied by `gain`
+ * after normalizing integer formats to +-1.
+ */
+void pcmToFloat(WavFormat format, const char* in, float* out, size_t count,
+                float gain);
+
+/**
+ * Converts `count` floats to interleaved file samples, `volts` mapping to
+ * full scale. The exact inverse of pcmToFloat() with `gain` = `volts`.
+ * Integer formats are dithered if enabled, then clipped at full scale.
+ */
+void floatToPcm(WavFormat format, const float* in, char* out, size_t count,
+                float volts, PcmDither* dither);
+
+void deinterleave(const float* in, int channels, int frames, float* planes,
+                  int stride);
+void interleave(const float* planes, int stride, int channels, int frames,
+                float* out);
+
+// Per-sample reference versions; the SSE versions fall back to them for tails
+// and unusual channel counts, and the benchmark compares against them.
+void pcmToFloatScalar(WavFormat format, const char* in, float* out,
+                      size_t count, float gain);
+void floatToPcmScalar(WavFormat format, const float* in, char* out,
+                      size_t count, float volts, PcmDither* dither);
+void deinterleaveScalar(const float* in, int channels, int frames,
+                        float* planes, int stride);
+void interleaveScalar(const float* planes, int stride, int channels,
+                      int frames, float* out);
@@ -0,0 +1,63 @@
+/**
+ * @file Resampler.hpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Streaming polyphase resampler for inputs at a foreign sample rate.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "Wav.hpp"
+
+/**
+ * Converts a WAV stream to the session rate while it is being read, with a
+ * Kaiser-windowed sinc split into polyphase branches.
+ *
+ * The rate ratio is kept as an exact fraction L/M, so output frame n always
+ * sits at input position n * M / L and seeking is sample-exact. Ratios with
+ * more than MAX_PHASES steps snap to the nearest of MAX_PHASES branches.
+ */
+struct Resampler {
+  static const int TAPS = 64;
+  static const int MAX_PHASES = 1024;
+  static const int CHUNK_FRAMES = 4096;
+
+  bool init(int in_rate, int out_rate, int channels);
+
+  /** Output length for an input of `in_frames` frames. */
+  int64_t outputFrames(int64_t in_frames) const;
+
+  /** Positions the stream so the next output frame is `out_frame`. */
+  bool seek(WavReader* reader, int64_t out_frame);
+
+  /**
+   * Renders `frames` output frames into planar volts, channel c at
+   * `planes + c * stride`, reading from `reader` as needed. Past the end of
+   * the input the filter tail rings out into silence. So does a failed
+   * read, which the caller finds in reader->ioError().
+   */
+  void process(WavReader* reader, float* planes, int stride, int frames);
+
+ private:
+  int64_t up = 1;
+  int64_t down = 1;
+  int phases = 1;
+  int channels = 0;
+  std::vector<float> table;
+
+  // Planar input history, `capacity` frames per channel. `base` is the
+  // first tap of the next output frame and `phase` its offset in 1/up steps.
+  std::vector<float> history;
+  int capacity = 0;
+  int filled = 0;
+  int base = 0;
+  int64_t phase = 0;
+
+  void refill(WavReader* reader);
+};
@@ -0,0 +1,437 @@
+/**
+ * @file Wav.cpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Minimal streaming WAV reader and writer, shared by the plugin and
+ * pass_render.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "Wav.hpp"
+
+#include "PcmConvert.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+static const int WAV_FORMAT_PCM = 1;
+static const int WAV_FORMAT_FLOAT = 3;
+static const int WAV_FORMAT_EXTENSIBLE = 0xfffe;
+// The header reserves a 28 byte JUNK chunk after "WAVE". It becomes the
+// ds64 chunk of an RF64 file when the data outgrows the 32 bit RIFF sizes.
+static const int WAV_DS64_BYTES = 28;
+static const int WAV_HEADER_BYTES = 44 + 8 + WAV_DS64_BYTES;
+static const uint32_t WAV_SIZE_IN_DS64 = 0xffffffffu;
+
+int wavSampleBytes(WavFormat format) {
+  switch (format) {
+    case WAV_INT16:
+      return 2;
+    case WAV_INT24:
+      return 3;
+    default:
+      return 4;
+  }
+}
+
+static uint16_t readU16(const char* p) {
+  uint16_t v;
+  std::memcpy(&v, p, 2);
+  return v;
+}
+
+static uint32_t readU32(const char* p) {
+  uint32_t v;
+  std::memcpy(&v, p, 4);
+  return v;
+}
+
+static uint64_t readU64(const char* p) {
+  uint64_t v;
+  std::memcpy(&v, p, 8);
+  return v;
+}
+
+static void writeU16(char* p, uint16_t v) { std::memcpy(p, &v, 2); }
+
+static void writeU32(char* p, uint32_t v) { std::memcpy(p, &v, 4); }
+
+static void writeU64(char* p, uint64_t v) { std::memcpy(p, &v, 8); }
+
+WavReader::~WavReader() { close(); }
+
+bool WavReader::open(const std::string& path, std::string* error) {
+  close();
+  io_error = 0;
+  fd = BlockIo::openFile(path, false, false);
+  if (fd < 0) {
+    *error = "cannot open " + path;
+    return false;
+  }
+
+  char header[12];
+  if (BlockIo::readAt(fd, header, 12, 0) != 12 ||
+      (std::memcmp(header, "RIFF", 4) != 0 &&
+       std::memcmp(header, "RF64", 4) != 0) ||
+      std::memcmp(header + 8, "WAVE", 4) != 0) {
+    *error = path + " is not a WAV file";
+    return false;
+  }
+
+  bool have_format = false;
+  uint64_t ds64_data_bytes = 0;
+  int64_t pos = 12;
+  char chunk[8];
+  while (BlockIo::readAt(fd, chunk, 8, pos) == 8) {
+    uint64_t size = readU32(chunk + 4);
+    pos += 8;
+
+    if (std::memcmp(chunk, "ds64", 4) == 0 && size >= 16) {
+      // RF64: the 64 bit RIFF and data sizes.
+      char ds64[16];
+      if (BlockIo::readAt(fd, ds64, 16, pos) != 16) break;
+      ds64_data_bytes = readU64(ds64 + 8);
+    } else if (std::memcmp(chunk, "fmt ", 4) == 0) {
+      std::vector<char> fmt(std::max<uint64_t>(size, 16));
+      if (BlockIo::readAt(fd, fmt.data(), size, pos) != (int64_t)size) break;
+      int tag = readU16(&fmt[0]);
+      int bits = readU16(&fmt[14]);
+      if (tag == WAV_FORMAT_EXTENSIBLE && size >= 26) {
+        tag = readU16(&fmt[24]);
+      }
+      info.channels = readU16(&fmt[2]);
+      info.sample_rate = readU32(&fmt[4]);
+
+      if (tag == WAV_FORMAT_PCM && bits == 16) {
+        info.format = WAV_INT16;
+      } else if (tag == WAV_FORMAT_PCM && bits == 24) {
+        info.format = WAV_INT24;
+      } else if (tag == WAV_FORMAT_PCM && bits == 32) {
+        info.format = WAV_INT32;
+      } else if (tag == WAV_FORMAT_FLOAT && bits == 32) {
+        info.format = WAV_FLOAT32;
+      } else {
+        *error = path + ": unsupported sample format";
+        return false;
+      }
+      have_format = true;
+    } else if (std::memcmp(chunk, "data", 4) == 0) {
+      if (!have_format || info.channels < 1) break;
+      if (size == WAV_SIZE_IN_DS64 && ds64_data_bytes > 0) {
+        size = ds64_data_bytes;
+      }
+      int frame_bytes = info.channels * wavSampleBytes(info.format);
+      info.frames = size / frame_bytes;
+      data_offset = pos;
+      data_end = data_offset + info.frames * frame_bytes;
+      if (!io.ready()) {
+        io.init(WAV_IO_DEPTH, WAV_IO_CHUNK);
+        requested.assign(WAV_IO_DEPTH, 0);
+        received.assign(WAV_IO_DEPTH, 0);
+      }
+      return seek(0);
+    }
+    pos += size + (size & 1);
+  }
+
+  *error = path + ": missing fmt or data chunk";
+  return false;
+}
+
+void WavReader::close() {
+  if (fd >= 0) {
+    drain();
+    BlockIo::closeFile(fd);
+    fd = -1;
+  }
+}
+
+bool WavReader::seek(int64_t frame) {
+  if (io_error) return false;
+  frame = std::min(frame, info.frames);
+  int frame_bytes = info.channels * wavSampleBytes(info.format);
+  drain();
+  next_offset = data_offset + frame * frame_bytes;
+  remaining = info.frames - frame;
+  readAhead();
+  return true;
+}
+
+void WavReader::readAhead() {
+  bool queued = false;
+  while (!idle.empty() && next_offset < data_end) {
+    int slot = idle.back();
+    idle.pop_back();
+    size_t bytes = (size_t)std::min<int64_t>(WAV_IO_CHUNK,
+                                             data_end - next_offset);
+    io.queueRead(fd, slot, next_offset, bytes);
+    requested[slot] = bytes;
+    received[slot] = -1;
+    ahead.push_back(slot);
+    next_offset += bytes;
+    queued = true;
+  }
+  if (queued) io.submit();
+}
+
+void WavReader::drain() {
+  int64_t result;
+  while (io.complete(&result) >= 0) {
+  }
+  ahead.clear();
+  idle.clear();
+  for (int slot = 0; slot < io.depth(); ++slot) {
+    idle.push_back(slot);
+  }
+  consumed = 0;
+}
+
+int WavReader::read(float* planes, int stride, int frames) {
+  if (io_error) return -1;
+  frames = (int)std::min<int64_t>(frames, remaining);
+  int sample_bytes = wavSampleBytes(info.format);
+  int channels = info.channels;
+  size_t frame_bytes = (size_t)channels * sample_bytes;
+  size_t wanted = (size_t)frames * frame_bytes;
+  raw.resize(wanted);
+
+  // Chunks may complete in any order but are consumed in file order.
+  size_t got = 0;
+  while (got < wanted && !ahead.empty()) {
+    int slot = ahead.front();
+    while (received[slot] < 0) {
+      int64_t result;
+      int done = io.complete(&result);
+      if (done < 0) {
+        received[slot] = 0;
+        break;
+      }
+      received[done] = std::max<int64_t>(0, result);
+      if (result < 0 && !io_error) io_error = (int)result;
+    }
+    if (io_error) {
+      // Not the end of the data: the caller has to know the rest is lost.
+      drain();
+      next_offset = data_end;
+      remaining = 0;
+      return -1;
+    }
+
+    size_t n = std::min(wanted - got, (size_t)received[slot] - consumed);
+    std::memcpy(&raw[got], io.buffer(slot) + consumed, n);
+    got += n;
+    consumed += n;
+    if (consumed < (size_t)received[slot]) break;
+
+    ahead.pop_front();
+    idle.push_back(slot);
+    consumed = 0;
+    if ((size_t)received[slot] < requested[slot]) {
+      // The file is shorter than its data chunk claims.
+      drain();
+      next_offset = data_end;
+      break;
+    }
+    readAhead();
+  }
+  frames = (int)(got / frame_bytes);
+  remaining -= frames;
+
+  samples.resize((size_t)frames * channels);
+  pcmToFloat(info.format, raw.data(), samples.data(), samples.size(),
+             WAV_VOLTS);
+  deinterleave(samples.data(), channels, frames, planes, stride);
+  return frames;
+}
+
+WavWriter::~WavWriter() { close(); }
+
+bool WavWriter::open(const std::string& path, const WavInfo& info,
+                     std::string* error) {
+  close();
+  this->info = info;
+  this->info.frames = 0;
+  updating = false;
+  fd = BlockIo::openFile(path, true, true);
+  if (fd < 0) {
+    *error = "cannot create " + path;
+    return false;
+  }
+  prepareIo();
+  // The header is written with the final sizes on close().
+  write_offset = WAV_HEADER_BYTES;
+  return true;
+}
+
+bool WavWriter::close() {
+  if (fd < 0) return true;
+
+  drain();
+  bool ok = !failed && (updating || writeHeader());
+  ok = BlockIo::closeFile(fd) && ok;
+  fd = -1;
+  return ok;
+}
+
+bool WavWriter::create(const std::string& path, const WavInfo& info,
+                       std::string* error) {
+  close();
+  this->info = info;
+  updating = false;
+  fd = BlockIo::openFile(path, true, true);
+  if (fd < 0) {
+    *error = "cannot create " + path;
+    return false;
+  }
+  bool ok = writeHeader();
+  ok = BlockIo::closeFile(fd) && ok;
+  fd = -1;
+  if (!ok) *error = "cannot write " + path;
+  return ok;
+}
+
+bool WavWriter::openForUpdate(const std::string& path, const WavInfo& info,
+                              std::string* error) {
+  close();
+  this->info = info;
+  updating = true;
+  fd = BlockIo::openFile(path, true, false);
+  if (fd < 0) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  prepareIo();
+  write_offset = WAV_HEADER_BYTES;
+  return true;
+}
+
+bool WavWriter::seek(int64_t frame) {
+  int frame_bytes = info.channels * wavSampleBytes(info.format);
+  flushBuffer();
+  write_offset = WAV_HEADER_BYTES + frame * frame_bytes;
+  if (dither) {
+    dither->position = (uint64_t)frame * info.channels;
+  }
+  return !failed;
+}
+
+/**
+ * Writes a plain RIFF header while the sizes fit in 32 bits, otherwise an
+ * RF64 one (EBU Tech 3306) with the sizes in its ds64 chunk.
+ */
+bool WavWriter::writeHeader() {
+  int sample_bytes = wavSampleBytes(info.format);
+  uint64_t data_bytes = (uint64_t)info.frames * info.channels * sample_bytes;
+  uint64_t riff_bytes = WAV_HEADER_BYTES - 8 + data_bytes;
+  bool rf64 = riff_bytes >= WAV_SIZE_IN_DS64;
+
+  char header[WAV_HEADER_BYTES] = {};
+  std::memcpy(header, rf64 ? "RF64" : "RIFF", 4);
+  writeU32(header + 4, rf64 ? WAV_SIZE_IN_DS64 : (uint32_t)riff_bytes);
+  std::memcpy(header + 8, "WAVE", 4);
+
+  char* ds64 = header + 12;
+  std::memcpy(ds64, rf64 ? "ds64" : "JUNK", 4);
+  writeU32(ds64 + 4, WAV_DS64_BYTES);
+  if (rf64) {
+    writeU64(ds64 + 8, riff_bytes);
+    writeU64(ds64 + 16, data_bytes);
+    writeU64(ds64 + 24, (uint64_t)info.frames);
+  }
+
+  char* fmt = ds64 + 8 + WAV_DS64_BYTES;
+  std::memcpy(fmt, "fmt ", 4);
+  writeU32(fmt + 4, 16);
+  writeU16(fmt + 8,
+           info.format == WAV_FLOAT32 ? WAV_FORMAT_FLOAT : WAV_FORMAT_PCM);
+  writeU16(fmt + 10, info.channels);
+  writeU32(fmt + 12, info.sample_rate);
+  writeU32(fmt + 16, info.sample_rate * info.channels * sample_bytes);
+  writeU16(fmt + 20, info.channels * sample_bytes);
+  writeU16(fmt + 22, sample_bytes * 8);
+  std::memcpy(fmt + 24, "data", 4);
+  writeU32(fmt + 28, rf64 ? WAV_SIZE_IN_DS64 : (uint32_t)data_bytes);
+
+  return BlockIo::writeAt(fd, header, WAV_HEADER_BYTES, 0);
+}
+
+bool WavWriter::write(const float* planes, int stride, int frames) {
+  int sample_bytes = wavSampleBytes(info.format);
+  int channels = info.channels;
+  raw.resize((size_t)frames * channels * sample_bytes);
+
+  samples.resize((size_t)frames * channels);
+  interleave(planes, stride, channels, frames, samples.data());
+  floatToPcm(info.format, samples.data(), raw.data(), samples.size(),
+             WAV_VOLTS, dither);
+
+  info.frames += frames;
+  append(raw.data(), raw.size());
+  return !failed;
+}
+
+void WavWriter::prepareIo() {
+  if (!io.ready()) {
+    io.init(WAV_IO_DEPTH, WAV_IO_CHUNK);
+    requested.assign(WAV_IO_DEPTH, 0);
+  }
+  idle.clear();
+  for (int slot = 0; slot < io.depth(); ++slot) {
+    idle.push_back(slot);
+  }
+  fill_slot = -1;
+  fill_bytes = 0;
+  failed = false;
+}
+
+void WavWriter::append(const char* data, size_t bytes) {
+  while (bytes > 0) {
+    if (fill_slot < 0) {
+      if (idle.empty()) reap();
+      fill_slot = idle.back();
+      idle.pop_back();
+      fill_bytes = 0;
+    }
+    size_t n = std::min(bytes, WAV_IO_CHUNK - fill_bytes);
+    std::memcpy(io.buffer(fill_slot) + fill_bytes, data, n);
+    fill_bytes += n;
+    data += n;
+    bytes -= n;
+    if (fill_bytes == WAV_IO_CHUNK) flushBuffer();
+  }
+}
+
+void WavWriter::flushBuffer() {
+  if (fill_slot < 0) return;
+  io.queueWrite(fd, fill_slot, write_offset, fill_bytes);
+  requested[fill_slot] = fill_bytes;
+  write_offset += fill_bytes;
+  fill_slot = -1;
+  io.submit();
+}
+
+void WavWriter::reap() {
+  int64_t result;
+  int slot = io.complete(&result);
+  if (slot < 0) {
+    // The I/O backend failed; the buffers are free again, their data lost.
+    failed = true;
+    idle.clear();
+    for (int s = 0; s < io.depth(); ++s) {
+      if (s != fill_slot) idle.push_back(s);
+    }
+    return;
+  }
+  if (result != (int64_t)requested[slot]) failed = true;
+  idle.push_back(slot);
+}
+
+void WavWriter::drain() {
+  flushBuffer();
+  while (io.pending() > 0) {
+    reap();
+  }
+}
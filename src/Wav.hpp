@@ -0,0 +1,145 @@
+/**
+ * @file Wav.hpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Minimal streaming WAV reader and writer, shared by the plugin and
+ * pass_render.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "BlockIo.hpp"
+
+// Full scale in a WAV file maps to +-10 V on the Pass bus, like Rack's Audio
+// module.
+static const float WAV_VOLTS = 10.f;
+
+// Read-ahead and write-behind of the data chunk: buffer size and number of
+// buffers in flight per file.
+static const size_t WAV_IO_CHUNK = 1 << 18;
+static const int WAV_IO_DEPTH = 4;
+
+enum WavFormat { WAV_INT16, WAV_INT24, WAV_INT32, WAV_FLOAT32 };
+
+struct PcmDither;
+
+struct WavInfo {
+  int channels = 0;
+  int sample_rate = 0;
+  WavFormat format = WAV_FLOAT32;
+  int64_t frames = 0;
+};
+
+int wavSampleBytes(WavFormat format);
+
+/**
+ * Reads PCM 16/24/32 bit and 32 bit float files (plain or extensible
+ * headers, RIFF or RF64). Little-endian hosts only.
+ *
+ * The data chunk is read ahead in WAV_IO_CHUNK sized pieces, WAV_IO_DEPTH
+ * of them in flight, so the next block is usually on its way while the
+ * current one is decoded.
+ */
+struct WavReader {
+  WavInfo info;
+
+  ~WavReader();
+  bool open(const std::string& path, std::string* error);
+  void close();
+  bool seek(int64_t frame);
+
+  /**
+   * Decodes up to `frames` frames into planar volts, channel c at
+   * `planes + c * stride`. Returns the number of frames read, fewer only at
+   * the end of the data, or -1 once a read from the file has failed.
+   */
+  int read(float* planes, int stride, int frames);
+
+  /** -errno of the first failed read since open(), 0 if none. */
+  int ioError() const { return io_error; }
+
+ private:
+  int fd = -1;
+  int io_error = 0;
+  int64_t data_offset = 0;
+  int64_t data_end = 0;
+  int64_t remaining = 0;
+  std::vector<char> raw;
+  std::vector<float> samples;
+
+  // Read-ahead: slots in file order, the bytes each asked for and got (-1
+  // while in flight), and how far the oldest one has been consumed.
+  BlockIo io;
+  int64_t next_offset = 0;
+  std::deque<int> ahead;
+  std::vector<int> idle;
+  std::vector<size_t> requested;
+  std::vector<int64_t> received;
+  size_t consumed = 0;
+
+  void readAhead();
+  void drain();
+};
+
+/**
+ * Writes behind: encoded data collects in WAV_IO_CHUNK sized buffers that
+ * are written while the next ones fill, up to WAV_IO_DEPTH at a time. Write
+ * errors may therefore surface on a later write() or on close().
+ *
+ * Files whose data outgrows the 4 GiB sizes of a RIFF header are finished
+ * as RF64.
+ */
+struct WavWriter {
+  WavInfo info;
+  PcmDither* dither = nullptr;
+
+  ~WavWriter();
+  bool open(const std::string& path, const WavInfo& info, std::string* error);
+  bool close();
+
+  /**
+   * Writes the header of a file of `info.frames` frames whose data is filled
+   * in later, possibly out of order, through openForUpdate() and seek().
+   */
+  bool create(const std::string& path, const WavInfo& info,
+              std::string* error);
+  bool openForUpdate(const std::string& path, const WavInfo& info,
+                     std::string* error);
+  bool seek(int64_t frame);
+
+  /**
+   * Encodes `frames` frames of planar volts, channel c at
+   * `planes + c * stride`, dithering integer formats if `dither` is set
+   * and clipping them at full scale.
+   */
+  bool write(const float* planes, int stride, int frames);
+
+ private:
+  int fd = -1;
+  bool updating = false;
+  bool failed = false;
+  std::vector<char> raw;
+  std::vector<float> samples;
+
+  BlockIo io;
+  int64_t write_offset = 0;
+  int fill_slot = -1;
+  size_t fill_bytes = 0;
+  std::vector<int> idle;
+  std::vector<size_t> requested;
+
+  bool writeHeader();
+  void prepareIo();
+  void append(const char* data, size_t bytes);
+  void flushBuffer();
+  void reap();
+  void drain();
+};
@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""Writes a .vcv patch with many Pass modules, for measuring engine CPU load.
+
+The patch is plain patch JSON, which Rack 2 loads like any .vcv file. Signal
+comes from VCV Fundamental VCOs, so that plugin must be installed.
+
+Topologies:
+  parallel  every Pass sums the same three VCO outputs
+  cascade   each Pass takes the previous Pass on IN 1, plus a VCO on IN 2/3
+  poly      the VCOs are merged into a 16 channel bus fanned out to every
+            Pass, with a mono VCO on IN 2 and IN 3
+
+examples:
+  tools/gen_stress_patch.py --count 500 --topology parallel -o parallel.vcv
+  tools/gen_stress_patch.py --count 64 --topology cascade --agc 0.5 -o c.vcv
+"""
+
+import argparse
+import json
+import random
+import sys
+
+RACK_VERSION = "2.4.1"
+PLUGIN = "DSP_FUNKS"
+PLUGIN_VERSION = "2.1.0"
+# First Fundamental release for Rack 2; any installed 2.x loads the modules.
+FUNDAMENTAL_VERSION = "2.0.0"
+
+# Pass port ids, see src/Pass.cpp.
+PASS_HP = 12
+PASS_IN = [0, 1, 2]
+PASS_OUT = 0
+
+# VCV Fundamental port ids.
+VCO_HP = 9
+VCO_OUTS = [0, 1, 2, 3]  # sine, triangle, saw, square
+MERGE_HP = 5
+MERGE_OUT = 0
+
+ROW_HP = 96
+
+
+class Patch:
+    def __init__(self):
+        self.modules = []
+        self.cables = []
+        self.x = 0
+        self.row = 0
+
+    def add_module(self, plugin, model, version, hp, data=None, params=None):
+        if self.x + hp > ROW_HP:
+            self.x = 0
+            self.row += 1
+        module = {
+            "id": len(self.modules) + 1,
+            "plugin": plugin,
+            "model": model,
+            "version": version,
+            "params": params or [],
+            "pos": [self.x, self.row],
+        }
+        if data is not None:
+            module["data"] = data
+        self.modules.append(module)
+        self.x += hp
+        return module["id"]
+
+    def connect(self, out_module, out_id, in_module, in_id):
+        self.cables.append({
+            "id": len(self.cables) + 1,
+            "outputModuleId": out_module,
+            "outputId": out_id,
+            "inputModuleId": in_module,
+            "inputId": in_id,
+            "color": "#f3374b",
+        })
+
+    def to_json(self):
+        return {
+            "version": RACK_VERSION,
+            "zoom": 1.0,
+            "gridOffset": [0.0, 0.0],
+            "modules": self.modules,
+            "cables": self.cables,
+        }
+
+
+def add_vco(patch, index):
+    # Spread the pitches a semitone apart, FREQ being in semitones, so sums
+    # are not trivially periodic.
+    params = [{"id": 2, "value": index % 12 - 6}]
+    return patch.add_module("Fundamental", "VCO", FUNDAMENTAL_VERSION, VCO_HP,
+                            params=params)
+
+
+def add_pass(patch, rng, agc_ratio, group):
+    data = {
+        "power": True,
+        "sum": rng.random() < 0.5,
+        "agc": rng.random() < agc_ratio,
+        "group": group,
+    }
+    data["avg"] = not data["sum"]
+    return patch.add_module(PLUGIN, "Pass", PLUGIN_VERSION, PASS_HP,
+                            data=data)
+
+
+def build(topology, count, seed, agc_ratio, group):
+    rng = random.Random(seed)
+    patch = Patch()
+    vcos = [add_vco(patch, i) for i in range(3)]
+
+    if topology == "parallel":
+        for _ in range(count):
+            p = add_pass(patch, rng, agc_ratio, group)
+            for vco, port in zip(vcos, PASS_IN):
+                patch.connect(vco, rng.choice(VCO_OUTS), p, port)
+
+    elif topology == "cascade":
+        previous = None
+        for _ in range(count):
+            p = add_pass(patch, rng, agc_ratio, group)
+            if previous is None:
+                patch.connect(vcos[0], 0, p, PASS_IN[0])
+            else:
+                patch.connect(previous, PASS_OUT, p, PASS_IN[0])
+            patch.connect(vcos[1], rng.choice(VCO_OUTS), p, PASS_IN[1])
+            patch.connect(vcos[2], rng.choice(VCO_OUTS), p, PASS_IN[2])
+            previous = p
+
+    elif topology == "poly":
+        merge = patch.add_module("Fundamental", "Merge", FUNDAMENTAL_VERSION,
+                                 MERGE_HP)
+        for channel in range(16):
+            patch.connect(vcos[channel % 3], VCO_OUTS[channel % 4], merge,
+                          channel)
+        for _ in range(count):
+            p = add_pass(patch, rng, agc_ratio, group)
+            patch.connect(merge, MERGE_OUT, p, PASS_IN[0])
+            patch.connect(vcos[1], rng.choice(VCO_OUTS), p, PASS_IN[1])
+            patch.connect(vcos[2], rng.choice(VCO_OUTS), p, PASS_IN[2])
+
+    return patch
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__.splitlines()[0],
+        epilog="\n".join(__doc__.splitlines()[4:]),
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--count", type=int, default=100,
+                        help="number of Pass modules (default 100)")
+    parser.add_argument("--topology", default="parallel",
+                        choices=["parallel", "cascade", "poly"])
+    parser.add_argument("--agc", type=float, default=0.0,
+                        help="fraction of Pass modules with AGC enabled")
+    parser.add_argument("--group", action="store_true",
+                        help="enable group processing on every Pass")
+    parser.add_argument("--seed", type=int, default=1,
+                        help="random seed for modes and wiring (default 1)")
+    parser.add_argument("-o", "--output", required=True,
+                        help="patch file to write")
+    args = parser.parse_args()
+
+    if args.count < 1:
+        parser.error("--count must be at least 1")
+
+    patch = build(args.topology, args.count, args.seed, args.agc,
+                  args.group)
+    with open(args.output, "w") as f:
+        json.dump(patch.to_json(), f, indent=2)
+    print("wrote %d modules and %d cables to %s" %
+          (len(patch.modules), len(patch.cables), args.output),
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
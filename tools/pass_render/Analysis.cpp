@@ -0,0 +1,295 @@
+/**
+ * @file Analysis.cpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Streaming level and loudness analysis of rendered output.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "Analysis.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+static const double PI = 3.14159265358979323846;
+
+// Gating per BS.1770-4: 400 ms blocks every 100 ms, an absolute gate at
+// -70 LUFS and a relative gate 10 LU below the absolutely gated level.
+static const double ABSOLUTE_GATE = -70.0;
+static const double RELATIVE_GATE = -10.0;
+static const double BIN_LU = 0.01;
+static const int BINS = 10000;
+
+// K-weighting filter design constants, as used by libebur128 to derive the
+// BS.1770 coefficients at any sample rate.
+static const double SHELF_FREQ = 1681.974450955533;
+static const double SHELF_GAIN_DB = 3.999843853973347;
+static const double SHELF_Q = 0.7071752369554196;
+static const double HIGHPASS_FREQ = 38.13547087602444;
+static const double HIGHPASS_Q = 0.5003270373238773;
+
+static double loudness(double energy) {
+  return -0.691 + 10.0 * std::log10(energy);
+}
+
+void Analyzer::init(int channels, int sample_rate) {
+  this->channels = channels;
+  this->sample_rate = sample_rate;
+  hop_frames = std::max(1, (int)std::lround(sample_rate * 0.1));
+  state.assign(channels, Channel());
+  block_counts.assign(BINS, 0);
+  block_energy.assign(BINS, 0.0);
+  counted_frames = 0;
+
+  double k = std::tan(PI * SHELF_FREQ / sample_rate);
+  double vh = std::pow(10.0, SHELF_GAIN_DB / 20.0);
+  double vb = std::pow(vh, 0.4996667741545416);
+  double a0 = 1.0 + k / SHELF_Q + k * k;
+  shelf_b[0] = (vh + vb * k / SHELF_Q + k * k) / a0;
+  shelf_b[1] = 2.0 * (k * k - vh) / a0;
+  shelf_b[2] = (vh - vb * k / SHELF_Q + k * k) / a0;
+  shelf_a[1] = 2.0 * (k * k - 1.0) / a0;
+  shelf_a[2] = (1.0 - k / SHELF_Q + k * k) / a0;
+
+  k = std::tan(PI * HIGHPASS_FREQ / sample_rate);
+  a0 = 1.0 + k / HIGHPASS_Q + k * k;
+  highpass_b[0] = 1.0;
+  highpass_b[1] = -2.0;
+  highpass_b[2] = 1.0;
+  highpass_a[1] = 2.0 * (k * k - 1.0) / a0;
+  highpass_a[2] = (1.0 - k / HIGHPASS_Q + k * k) / a0;
+
+  // Phase p interpolates at TP_TAPS / 2 - 1 + p / TP_PHASES, counted from
+  // the oldest tap, with a Hann-windowed sinc normalized to unity gain.
+  for (int p = 0; p < TP_PHASES; ++p) {
+    double t = TP_TAPS / 2 - 1 + (double)p / TP_PHASES;
+    double gain = 0.0;
+    for (int k = 0; k < TP_TAPS; ++k) {
+      double d = k - t;
+      double sinc = d == 0.0 ? 1.0 : std::sin(PI * d) / (PI * d);
+      double window = 0.5 + 0.5 * std::cos(PI * d / (TP_TAPS / 2 + 0.5));
+      tp_table[p][k] = sinc * window;
+      gain += tp_table[p][k];
+    }
+    for (int k = 0; k < TP_TAPS; ++k) {
+      tp_table[p][k] /= gain;
+    }
+  }
+
+  seek(0, 0);
+}
+
+int Analyzer::warmupFrames() const {
+  // Three hops complete the first counted block; the K-weighting high pass
+  // has decayed far below the measurement precision after half a second.
+  return 8 * hop_frames;
+}
+
+void Analyzer::seek(int64_t position, int64_t count_from) {
+  this->position = position;
+  this->count_from = count_from;
+  for (Channel& channel : state) {
+    std::fill(channel.shelf, channel.shelf + 2, 0.0);
+    std::fill(channel.highpass, channel.highpass + 2, 0.0);
+    std::fill(channel.history, channel.history + 2 * TP_TAPS, 0.0);
+  }
+  history_pos = 0;
+  hop_energy = 0.0;
+  hop_fill = (int)(position % hop_frames);
+  hops_done = hop_fill > 0 ? -1 : 0;
+}
+
+void Analyzer::process(const float* planes, int stride, int frames) {
+  for (int f = 0; f < frames; ++f) {
+    processFrame(planes, stride, f);
+  }
+}
+
+void Analyzer::processFrame(const float* planes, int stride, int f) {
+  bool counted = position >= count_from;
+  double frame_energy = 0.0;
+
+  for (int c = 0; c < channels; ++c) {
+    Channel& channel = state[c];
+    double x = planes[c * stride + f] / WAV_VOLTS;
+
+    if (counted) {
+      double level = std::fabs(x);
+      channel.peak = std::max(channel.peak, level);
+      channel.sum += x;
+      channel.sum_sq += x * x;
+      if (level >= 1.0) ++channel.clips;
+    }
+    pushTruePeak(channel, x, counted);
+
+    double y = shelf_b[0] * x + channel.shelf[0];
+    channel.shelf[0] = shelf_b[1] * x - shelf_a[1] * y + channel.shelf[1];
+    channel.shelf[1] = shelf_b[2] * x - shelf_a[2] * y;
+    double z = highpass_b[0] * y + channel.highpass[0];
+    channel.highpass[0] =
+        highpass_b[1] * y - highpass_a[1] * z + channel.highpass[1];
+    channel.highpass[1] = highpass_b[2] * y - highpass_a[2] * z;
+    frame_energy += z * z;
+  }
+  history_pos = (history_pos + 1) % TP_TAPS;
+
+  if (counted) ++counted_frames;
+  ++position;
+  hop_energy += frame_energy;
+  if (++hop_fill == hop_frames) {
+    endHop();
+  }
+}
+
+void Analyzer::pushTruePeak(Channel& channel, double x, bool counted) {
+  channel.history[history_pos] = x;
+  channel.history[history_pos + TP_TAPS] = x;
+  if (!counted) return;
+
+  // Oldest to newest sample of the window.
+  const double* window = channel.history + history_pos + 1;
+  for (int p = 0; p < TP_PHASES; ++p) {
+    double value = 0.0;
+    for (int k = 0; k < TP_TAPS; ++k) {
+      value += window[k] * tp_table[p][k];
+    }
+    channel.true_peak = std::max(channel.true_peak, std::fabs(value));
+  }
+  channel.true_peak = std::max(channel.true_peak, std::fabs(x));
+}
+
+void Analyzer::finish() {
+  for (int i = 0; i < TP_TAPS / 2; ++i) {
+    for (Channel& channel : state) {
+      pushTruePeak(channel, 0.0, true);
+    }
+    history_pos = (history_pos + 1) % TP_TAPS;
+  }
+}
+
+void Analyzer::endHop() {
+  double energy = hop_energy;
+  hop_energy = 0.0;
+  hop_fill = 0;
+  // A hop cut short by a seek is not a full hop.
+  if (hops_done < 0) {
+    hops_done = 0;
+    return;
+  }
+  hops[hops_done++ % 4] = energy;
+
+  // The block ending here belongs to whoever counts its last frame.
+  if (hops_done < 4 || position <= count_from) return;
+  energy = (hops[0] + hops[1] + hops[2] + hops[3]) / (4 * hop_frames);
+  if (energy <= 0.0) return;
+  double level = loudness(energy);
+  if (level < ABSOLUTE_GATE) return;
+
+  int bin = std::min(BINS - 1, (int)((level - ABSOLUTE_GATE) / BIN_LU));
+  ++block_counts[bin];
+  block_energy[bin] += energy;
+}
+
+void Analyzer::merge(const Analyzer& other) {
+  for (int c = 0; c < channels; ++c) {
+    Channel& channel = state[c];
+    const Channel& theirs = other.state[c];
+    channel.peak = std::max(channel.peak, theirs.peak);
+    channel.true_peak = std::max(channel.true_peak, theirs.true_peak);
+    channel.sum += theirs.sum;
+    channel.sum_sq += theirs.sum_sq;
+    channel.clips += theirs.clips;
+  }
+  counted_frames += other.counted_frames;
+  for (int b = 0; b < BINS; ++b) {
+    block_counts[b] += other.block_counts[b];
+    block_energy[b] += other.block_energy[b];
+  }
+}
+
+/** Writes a level in dB, or null for silence, which JSON cannot express. */
+static void writeDb(FILE* file, double level) {
+  if (level > 0.0) {
+    std::fprintf(file, "%.2f", 20.0 * std::log10(level));
+  } else {
+    std::fprintf(file, "null");
+  }
+}
+
+static void writeString(FILE* file, const std::string& text) {
+  std::fputc('"', file);
+  for (char ch : text) {
+    if (ch == '"' || ch == '\\') std::fputc('\\', file);
+    std::fputc(ch, file);
+  }
+  std::fputc('"', file);
+}
+
+bool Analyzer::writeReport(const std::string& path, const std::string& file,
+                           const WavInfo& info) const {
+  int64_t total = 0;
+  double energy = 0.0;
+  for (int b = 0; b < BINS; ++b) {
+    total += block_counts[b];
+    energy += block_energy[b];
+  }
+  double integrated = 0.0;
+  bool gated = total > 0;
+  if (gated) {
+    double threshold = loudness(energy / total) + RELATIVE_GATE;
+    total = 0;
+    energy = 0.0;
+    for (int b = 0; b < BINS; ++b) {
+      if (ABSOLUTE_GATE + (b + 0.5) * BIN_LU < threshold) continue;
+      total += block_counts[b];
+      energy += block_energy[b];
+    }
+    gated = total > 0;
+    if (gated) integrated = loudness(energy / total);
+  }
+
+  double peak = 0.0;
+  double true_peak = 0.0;
+  for (const Channel& channel : state) {
+    peak = std::max(peak, channel.peak);
+    true_peak = std::max(true_peak, channel.true_peak);
+  }
+
+  FILE* out = std::fopen(path.c_str(), "w");
+  if (!out) return false;
+  std::fprintf(out, "{\n  \"file\": ");
+  writeString(out, file);
+  std::fprintf(out,
+               ",\n  \"sampleRate\": %d,\n  \"channels\": %d,\n"
+               "  \"frames\": %lld,\n  \"integratedLufs\": ",
+               info.sample_rate, channels, (long long)counted_frames);
+  if (gated) {
+    std::fprintf(out, "%.2f", integrated);
+  } else {
+    std::fprintf(out, "null");
+  }
+  std::fprintf(out, ",\n  \"peakDbfs\": ");
+  writeDb(out, peak);
+  std::fprintf(out, ",\n  \"truePeakDbtp\": ");
+  writeDb(out, true_peak);
+  std::fprintf(out, ",\n  \"channelStats\": [");
+
+  double frames = std::max<int64_t>(1, counted_frames);
+  for (int c = 0; c < channels; ++c) {
+    const Channel& channel = state[c];
+    std::fprintf(out, "%s\n    {\"peakDbfs\": ", c ? "," : "");
+    writeDb(out, channel.peak);
+    std::fprintf(out, ", \"truePeakDbtp\": ");
+    writeDb(out, channel.true_peak);
+    std::fprintf(out, ", \"rmsDbfs\": ");
+    writeDb(out, std::sqrt(channel.sum_sq / frames));
+    std::fprintf(out, ", \"dcOffsetVolts\": %.6f, \"clips\": %lld}",
+                 channel.sum / frames * WAV_VOLTS, (long long)channel.clips);
+  }
+  std::fprintf(out, "\n  ]\n}\n");
+  return std::fclose(out) == 0;
+}
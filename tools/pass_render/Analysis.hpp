@@ -0,0 +1,105 @@
+/**
+ * @file Analysis.hpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Streaming level and loudness analysis of rendered output.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../../src/Wav.hpp"
+
+/**
+ * Measures peak, true peak, RMS, DC offset and clipped samples per channel,
+ * and integrated loudness per ITU-R BS.1770, while the audio streams past.
+ * Memory does not grow with the length of the file: gating blocks are
+ * binned into a fixed histogram of 0.01 LU bins instead of being stored.
+ *
+ * Levels are relative to the WAV full scale of WAV_VOLTS. All channels get
+ * loudness weight 1, since Pass buses carry poly voices rather than a
+ * surround layout.
+ *
+ * Analyzers of disjoint parts of a file can be merged: seek() restarts the
+ * filters at any frame, and only frames from `count_from` on are counted,
+ * so the frames before it act as pre-roll.
+ */
+struct Analyzer {
+  // True peak interpolator: 4x oversampling with TP_TAPS taps per phase.
+  static const int TP_PHASES = 4;
+  static const int TP_TAPS = 12;
+
+  void init(int channels, int sample_rate);
+
+  /**
+   * Frames of pre-roll a restarted analyzer needs so that its filters have
+   * settled and every gating block ending at `count_from` is complete.
+   */
+  int warmupFrames() const;
+
+  /** Frames per 100 ms gating hop; segment boundaries must align to it. */
+  int hopFrames() const { return hop_frames; }
+
+  void seek(int64_t position, int64_t count_from);
+
+  /** Analyzes planar volts, channel c at `planes + c * stride`. */
+  void process(const float* planes, int stride, int frames);
+
+  /** Flushes the true peak interpolator at the end of the file. */
+  void finish();
+
+  void merge(const Analyzer& other);
+
+  bool writeReport(const std::string& path, const std::string& file,
+                   const WavInfo& info) const;
+
+ private:
+  struct Channel {
+    double peak = 0.0;
+    double true_peak = 0.0;
+    double sum = 0.0;
+    double sum_sq = 0.0;
+    int64_t clips = 0;
+
+    // K-weighting: shelf and high pass biquads, transposed direct form II.
+    double shelf[2] = {};
+    double highpass[2] = {};
+    // Doubled ring of the last TP_TAPS samples, so every window is
+    // contiguous.
+    double history[2 * TP_TAPS] = {};
+  };
+
+  int channels = 0;
+  int sample_rate = 0;
+  int hop_frames = 0;
+  std::vector<Channel> state;
+  double tp_table[TP_PHASES][TP_TAPS] = {};
+  double shelf_b[3] = {};
+  double shelf_a[3] = {};
+  double highpass_b[3] = {};
+  double highpass_a[3] = {};
+
+  int64_t position = 0;
+  int64_t count_from = 0;
+  int64_t counted_frames = 0;
+  int history_pos = 0;
+
+  // The last four hops make one 400 ms gating block.
+  double hop_energy = 0.0;
+  int hop_fill = 0;
+  double hops[4] = {};
+  int hops_done = 0;
+
+  std::vector<int64_t> block_counts;
+  std::vector<double> block_energy;
+
+  void processFrame(const float* planes, int stride, int f);
+  void pushTruePeak(Channel& channel, double x, bool counted);
+  void endHop();
+};
@@ -0,0 +1,95 @@
+/**
+ * @file Pipeline.hpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Reader/DSP/writer stages of pass_render and the queues between them.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "../../src/PassEngine.hpp"
+
+/**
+ * Bounded single-producer/single-consumer queue. Each stage of the pipeline
+ * owns one end, so plain acquire/release indices are enough. push() and
+ * pop() sleep on a condition variable while the queue is full or empty;
+ * blocks are large, so the lock taken to wake the other end costs nothing
+ * measurable.
+ */
+template <typename T>
+struct SpscQueue {
+  explicit SpscQueue(size_t capacity) : slots(capacity + 1) {}
+
+  bool tryPush(const T& value) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t next = (t + 1) % slots.size();
+    if (next == head.load(std::memory_order_acquire)) return false;
+    slots[t] = value;
+    tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool tryPop(T* value) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) return false;
+    *value = slots[h];
+    head.store((h + 1) % slots.size(), std::memory_order_release);
+    return true;
+  }
+
+  void push(const T& value) {
+    if (!tryPush(value)) {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&]() { return tryPush(value); });
+    }
+    notify();
+  }
+
+  T pop() {
+    T value;
+    if (!tryPop(&value)) {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&]() { return tryPop(&value); });
+    }
+    notify();
+    return value;
+  }
+
+ private:
+  // Taken by the waker too, so a wakeup cannot slip in between the other
+  // end's failed try and its wait.
+  std::mutex mutex;
+  std::condition_variable changed;
+
+  void notify() {
+    std::lock_guard<std::mutex> lock(mutex);
+    changed.notify_one();
+  }
+
+  std::vector<T> slots;
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) std::atomic<size_t> tail{0};
+};
+
+/**
+ * One block of planar audio travelling through the pipeline. Blocks are
+ * allocated once and recycled; `frames == 0` marks the end of the stream.
+ */
+struct RenderBlock {
+  int frames = 0;
+  std::vector<float> inputs[PassEngine::MAX_INPUTS];
+  std::vector<float> output;
+
+  // Double precision copies of the above, only allocated for --double.
+  std::vector<double> wide_inputs[PassEngine::MAX_INPUTS];
+  std::vector<double> wide_output;
+};
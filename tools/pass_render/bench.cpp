@@ -0,0 +1,230 @@
+/**
+ * @file bench.cpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief Throughput of the pass_render sample format conversions and of the
+ * Pass engine per sample type, plus checks of the engine's AVG modes.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../../src/PassEngine.hpp"
+#include "../../src/PcmConvert.hpp"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+
+/** Minimal 4-lane vector standing in for Rack's float_4 outside the SDK. */
+struct Vec4 {
+  __m128 v;
+
+  Vec4() {}
+  Vec4(float x) : v(_mm_set1_ps(x)) {}
+  Vec4(__m128 v) : v(v) {}
+
+  Vec4& operator+=(Vec4 b) {
+    v = _mm_add_ps(v, b.v);
+    return *this;
+  }
+  Vec4& operator*=(Vec4 b) {
+    v = _mm_mul_ps(v, b.v);
+    return *this;
+  }
+};
+
+template <>
+struct SampleLanes<Vec4> {
+  static const int value = 4;
+  typedef float scalar;
+};
+#endif
+
+static const int FRAMES = 4096;
+static const int REPEATS = 100;
+static const int TRIALS = 7;
+
+typedef std::chrono::steady_clock Clock;
+
+/** Best of several timed trials, which filters out scheduling noise. */
+template <typename F>
+static double timeBest(F run) {
+  double best = 1e9;
+  for (int t = 0; t < TRIALS; ++t) {
+    Clock::time_point start = Clock::now();
+    for (int r = 0; r < REPEATS; ++r) {
+      run();
+    }
+    best = std::min(
+        best, std::chrono::duration<double>(Clock::now() - start).count());
+  }
+  return best;
+}
+
+static void benchFormat(WavFormat format, const char* name, int channels) {
+  size_t count = (size_t)FRAMES * channels;
+  size_t bytes = count * wavSampleBytes(format);
+  std::vector<char> raw(bytes);
+  std::vector<float> samples(count);
+  std::vector<float> planes(count);
+  std::vector<float> reference(count);
+  PcmDither dither;
+
+  for (size_t i = 0; i < count; ++i) {
+    samples[i] = 9.f * std::sin(i * 0.01f);
+  }
+  floatToPcmScalar(format, samples.data(), raw.data(), count, 10.f, nullptr);
+
+  double read_scalar = timeBest([&]() {
+    pcmToFloatScalar(format, raw.data(), samples.data(), count, 10.f);
+    deinterleaveScalar(samples.data(), channels, FRAMES, reference.data(),
+                       FRAMES);
+  });
+  double read_simd = timeBest([&]() {
+    pcmToFloat(format, raw.data(), samples.data(), count, 10.f);
+    deinterleave(samples.data(), channels, FRAMES, planes.data(), FRAMES);
+  });
+
+  float read_error = 0.f;
+  for (size_t i = 0; i < count; ++i) {
+    read_error = std::fmax(read_error, std::fabs(planes[i] - reference[i]));
+  }
+
+  double write_scalar = timeBest([&]() {
+    interleaveScalar(planes.data(), FRAMES, channels, FRAMES, samples.data());
+    floatToPcmScalar(format, samples.data(), raw.data(), count, 10.f,
+                     &dither);
+  });
+  double write_simd = timeBest([&]() {
+    interleave(planes.data(), FRAMES, channels, FRAMES, samples.data());
+    floatToPcm(format, samples.data(), raw.data(), count, 10.f, &dither);
+  });
+
+  double mb = (double)bytes * REPEATS / 1e6;
+  std::printf("%-6s %2d ch  read %8.0f -> %8.0f MB/s  write %8.0f -> %8.0f "
+              "MB/s  max read error %g\n",
+              name, channels, mb / read_scalar, mb / read_simd,
+              mb / write_scalar, mb / write_simd, read_error);
+}
+
+/**
+ * Times AVG over three 16 channel inputs with the engine instantiated on T.
+ * `planes` holds 16 channel rows of FRAMES floats, which vector types read
+ * as 16 / LANES rows of FRAMES vectors.
+ */
+template <typename T>
+static double benchEngine(const std::vector<float>* planes,
+                          std::vector<float>* out) {
+  typedef typename SampleLanes<T>::scalar Scalar;
+  const int lanes = SampleLanes<T>::value;
+  std::vector<T> in[3];
+  std::vector<T> sum(16 / lanes * FRAMES);
+  for (int i = 0; i < 3; ++i) {
+    in[i].resize(16 / lanes * FRAMES);
+    // Vector rows interleave `lanes` channels per frame.
+    Scalar* flat = (Scalar*)in[i].data();
+    for (int c = 0; c < 16; ++c) {
+      for (int f = 0; f < FRAMES; ++f) {
+        flat[(c / lanes * FRAMES + f) * lanes + c % lanes] =
+            planes[i][c * FRAMES + f];
+      }
+    }
+  }
+  const T* ptrs[3] = {in[0].data(), in[1].data(), in[2].data()};
+  const int channels[3] = {16, 16, 16};
+  TPassEngine<T> engine;
+  engine.average = true;
+
+  double seconds = timeBest(
+      [&]() { engine.process(ptrs, channels, sum.data(), FRAMES, FRAMES); });
+
+  const Scalar* flat = (const Scalar*)sum.data();
+  for (int c = 0; c < 16; ++c) {
+    for (int f = 0; f < FRAMES; ++f) {
+      (*out)[c * FRAMES + f] =
+          flat[(c / lanes * FRAMES + f) * lanes + c % lanes];
+    }
+  }
+  return seconds;
+}
+
+static void benchEngines() {
+  std::vector<float> planes[3];
+  for (int i = 0; i < 3; ++i) {
+    planes[i].resize(16 * FRAMES);
+    for (int k = 0; k < 16 * FRAMES; ++k) {
+      planes[i][k] = 5.f * std::sin(k * 0.001f * (i + 1));
+    }
+  }
+  std::vector<float> reference(16 * FRAMES);
+  std::vector<float> result(16 * FRAMES);
+  double samples = 3.0 * 16 * FRAMES * REPEATS / 1e6;
+
+  double seconds = benchEngine<double>(planes, &reference);
+  std::printf("engine double  %8.0f Msamples/s\n", samples / seconds);
+
+  seconds = benchEngine<float>(planes, &result);
+  float error = 0.f;
+  for (int k = 0; k < 16 * FRAMES; ++k) {
+    error = std::fmax(error, std::fabs(result[k] - reference[k]));
+  }
+  std::printf("engine float   %8.0f Msamples/s  max error %g V\n",
+              samples / seconds, error);
+
+#if defined(__SSE__)
+  seconds = benchEngine<Vec4>(planes, &result);
+  error = 0.f;
+  for (int k = 0; k < 16 * FRAMES; ++k) {
+    error = std::fmax(error, std::fabs(result[k] - reference[k]));
+  }
+  std::printf("engine float_4 %8.0f Msamples/s  max error %g V\n",
+              samples / seconds, error);
+#endif
+}
+
+/**
+ * Gated AVG of one 4 voice input with the gates of voices 1 and 3 high must
+ * be the mean of those two voices alone. Returns false on a mismatch.
+ */
+static bool checkGatedAverage() {
+  const float voices[4] = {1.f, 2.f, 5.f, 8.f};
+  const int channels[3] = {4, 0, 0};
+  float factors[16];
+  int gated = PassEngine::gatedFactors(channels, 0x5, factors);
+  float mean = 0.f;
+  for (int c = 0; c < 4; ++c) {
+    mean += voices[c] * factors[c];
+  }
+  float expected = (voices[0] + voices[2]) / 2.f;
+  std::printf("gated AVG, 4 voices, 2 gates high: %g V over %d voices, "
+              "expected %g V over 2\n",
+              mean, gated, expected);
+  return gated == 2 && std::fabs(mean - expected) < 1e-6f;
+}
+
+int main() {
+  std::printf("scalar -> vectorized throughput of file bytes, %d frames\n",
+              FRAMES);
+  const WavFormat formats[] = {WAV_INT16, WAV_INT24, WAV_INT32, WAV_FLOAT32};
+  const char* names[] = {"int16", "int24", "int32", "float"};
+  const int channel_counts[] = {1, 2, 3, 16};
+  for (int f = 0; f < 4; ++f) {
+    for (int channels : channel_counts) {
+      benchFormat(formats[f], names[f], channels);
+    }
+  }
+
+  std::printf("\nAVG of 3 x 16 channels, input samples per second\n");
+  benchEngines();
+
+  std::printf("\n");
+  return checkGatedAverage() ? 0 : 1;
+}
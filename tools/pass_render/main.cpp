@@ -0,0 +1,578 @@
+/**
+ * @file main.cpp
+ * @author Casey Stijlaart (casey.stijlaart@hotmail.com)
+ * @brief pass_render: renders WAV files through the Pass engine offline.
+ * @version 1.0
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Analysis.hpp"
+#include "../../src/PcmConvert.hpp"
+#include "Pipeline.hpp"
+#include "../../src/Resampler.hpp"
+#include "../../src/Wav.hpp"
+
+static const int POOL_BLOCKS = 8;
+
+struct RenderOptions {
+  std::string inputs[PassEngine::MAX_INPUTS];
+  int num_inputs = 0;
+  std::string output;
+  bool average = false;
+  WavFormat format = WAV_FLOAT32;
+  int block_frames = 4096;
+  int jobs = 1;
+  bool dither = false;
+  bool wide = false;
+  int sample_rate = 0;
+  std::string report;
+  std::string batch;
+};
+
+static void printUsage() {
+  std::fprintf(stderr,
+               "usage: pass_render [options] -o OUT.wav IN1.wav [IN2.wav "
+               "[IN3.wav]]\n"
+               "  --avg        average the inputs instead of summing them\n"
+               "  --format F   output format: 16, 24, 32 or float (default)\n"
+               "  --dither     TPDF dither 16 and 24 bit output\n"
+               "  --double     sum and average in double precision\n"
+               "  --rate R     session sample rate; inputs at other rates are\n"
+               "               resampled (default: rate of IN1)\n"
+               "  --report P   write peak, true peak, RMS, DC, clip and\n"
+               "               loudness statistics of the output to P as JSON\n"
+               "  --block N    frames per pipeline block (default 4096)\n"
+               "  --sync-io    use pread/pwrite even where io_uring is\n"
+               "               available\n"
+               "  --jobs N     render N segments in parallel, 0 for all "
+               "cores\n"
+               "  --batch P    instead of -o and inputs, render each line of "
+               "P,\n"
+               "               OUT.wav IN1.wav [IN2.wav [IN3.wav]], in turn\n"
+               "               with the same options and I/O rings\n");
+}
+
+static bool parseOptions(int argc, char** argv, RenderOptions* options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--avg") {
+      options->average = true;
+    } else if (arg == "--dither") {
+      options->dither = true;
+    } else if (arg == "--double") {
+      options->wide = true;
+    } else if (arg == "--sync-io") {
+      BlockIo::uring_allowed = false;
+    } else if (arg == "-o" && has_value) {
+      options->output = argv[++i];
+    } else if (arg == "--report" && has_value) {
+      options->report = argv[++i];
+    } else if (arg == "--batch" && has_value) {
+      options->batch = argv[++i];
+    } else if (arg == "--block" && has_value) {
+      options->block_frames = std::atoi(argv[++i]);
+    } else if (arg == "--rate" && has_value) {
+      options->sample_rate = std::atoi(argv[++i]);
+      if (options->sample_rate <= 0) return false;
+    } else if (arg == "--jobs" && has_value) {
+      options->jobs = std::atoi(argv[++i]);
+      if (options->jobs <= 0) {
+        options->jobs = std::max(1u, std::thread::hardware_concurrency());
+      }
+    } else if (arg == "--format" && has_value) {
+      std::string format = argv[++i];
+      if (format == "16") {
+        options->format = WAV_INT16;
+      } else if (format == "24") {
+        options->format = WAV_INT24;
+      } else if (format == "32") {
+        options->format = WAV_INT32;
+      } else if (format == "float") {
+        options->format = WAV_FLOAT32;
+      } else {
+        return false;
+      }
+    } else if (arg[0] != '-' &&
+               options->num_inputs < PassEngine::MAX_INPUTS) {
+      options->inputs[options->num_inputs++] = arg;
+    } else {
+      return false;
+    }
+  }
+  if (!options->batch.empty()) {
+    // Batch files render one at a time, each with its own output only.
+    return options->num_inputs == 0 && options->output.empty() &&
+           options->report.empty() && options->jobs == 1 &&
+           options->block_frames > 0;
+  }
+  return options->num_inputs > 0 && !options->output.empty() &&
+         options->block_frames > 0;
+}
+
+/**
+ * The input files of a render, opened and checked against each other.
+ */
+struct RenderInputs {
+  std::string paths[PassEngine::MAX_INPUTS];
+  WavReader readers[PassEngine::MAX_INPUTS];
+  Resampler resamplers[PassEngine::MAX_INPUTS];
+  bool resampled[PassEngine::MAX_INPUTS] = {};
+  int channels[PassEngine::MAX_INPUTS] = {};
+  int num_inputs = 0;
+  int64_t frames = 0;
+  int sample_rate = 0;
+  bool wide = false;
+
+  bool open(const RenderOptions& options, std::string* error) {
+    // Readers are reused across the files of a batch.
+    for (int i = options.num_inputs; i < PassEngine::MAX_INPUTS; ++i) {
+      readers[i].close();
+    }
+    num_inputs = options.num_inputs;
+    frames = 0;
+    wide = options.wide;
+    sample_rate = options.sample_rate;
+    for (int i = 0; i < num_inputs; ++i) {
+      paths[i] = options.inputs[i];
+      if (!readers[i].open(options.inputs[i], error)) return false;
+      const WavInfo& info = readers[i].info;
+      if (info.channels > PassEngine::MAX_CHANNELS) {
+        *error = options.inputs[i] + ": more than 16 channels";
+        return false;
+      }
+      if (!sample_rate) {
+        sample_rate = info.sample_rate;
+      }
+      channels[i] = info.channels;
+
+      resampled[i] = info.sample_rate != sample_rate;
+      int64_t input_frames = info.frames;
+      if (resampled[i]) {
+        if (!resamplers[i].init(info.sample_rate, sample_rate,
+                                info.channels)) {
+          *error = options.inputs[i] + ": invalid sample rate";
+          return false;
+        }
+        input_frames = resamplers[i].outputFrames(info.frames);
+      }
+      frames = std::max(frames, input_frames);
+    }
+    return true;
+  }
+
+  bool seek(int64_t frame) {
+    for (int i = 0; i < num_inputs; ++i) {
+      bool ok = resampled[i] ? resamplers[i].seek(&readers[i], frame)
+                             : readers[i].seek(frame);
+      if (!ok) return false;
+    }
+    return true;
+  }
+
+  void allocate(RenderBlock* block, int out_channels, int block_frames) {
+    for (int i = 0; i < num_inputs; ++i) {
+      block->inputs[i].resize(channels[i] * block_frames);
+    }
+    block->output.resize(out_channels * block_frames);
+    if (!wide) return;
+    for (int i = 0; i < num_inputs; ++i) {
+      block->wide_inputs[i].resize(channels[i] * block_frames);
+    }
+    block->wide_output.resize(out_channels * block_frames);
+  }
+
+  /** Fails if an input could not be read, which is not its end. */
+  bool read(RenderBlock* block, int block_frames, std::string* error) {
+    for (int i = 0; i < num_inputs; ++i) {
+      float* planes = block->inputs[i].data();
+      int read = block->frames;
+      if (resampled[i]) {
+        resamplers[i].process(&readers[i], planes, block_frames,
+                              block->frames);
+      } else {
+        read = readers[i].read(planes, block_frames, block->frames);
+      }
+      if (readers[i].ioError()) {
+        *error = "cannot read " + paths[i] + ": " +
+                 std::strerror(-readers[i].ioError());
+        return false;
+      }
+      // Inputs that ran out keep contributing silence, like a patched cable
+      // carrying 0 V.
+      for (int c = 0; c < channels[i]; ++c) {
+        std::fill(planes + c * block_frames + read,
+                  planes + c * block_frames + block->frames, 0.f);
+      }
+    }
+    return true;
+  }
+
+  void process(const PassEngine& engine, RenderBlock* block,
+               int block_frames) const {
+    if (wide) {
+      processWide(engine, block, block_frames);
+      return;
+    }
+    const float* planes[PassEngine::MAX_INPUTS] = {};
+    for (int i = 0; i < num_inputs; ++i) {
+      planes[i] = block->inputs[i].data();
+    }
+    engine.process(planes, channels, block->output.data(), block_frames,
+                   block->frames);
+  }
+
+  /**
+   * Runs the same engine on double samples, rounding to float only once on
+   * the way out.
+   */
+  void processWide(const PassEngine& engine, RenderBlock* block,
+                   int block_frames) const {
+    TPassEngine<double> wide_engine;
+    wide_engine.average = engine.average;
+
+    const double* planes[PassEngine::MAX_INPUTS] = {};
+    for (int i = 0; i < num_inputs; ++i) {
+      for (int c = 0; c < channels[i]; ++c) {
+        const float* src = block->inputs[i].data() + c * block_frames;
+        std::copy(src, src + block->frames,
+                  block->wide_inputs[i].data() + c * block_frames);
+      }
+      planes[i] = block->wide_inputs[i].data();
+    }
+    wide_engine.process(planes, channels, block->wide_output.data(),
+                        block_frames, block->frames);
+
+    int out_channels = PassEngine::outputChannels(channels);
+    for (int c = 0; c < out_channels; ++c) {
+      const double* src = block->wide_output.data() + c * block_frames;
+      std::copy(src, src + block->frames,
+                block->output.data() + c * block_frames);
+    }
+  }
+
+  WavInfo outputInfo(WavFormat format) const {
+    WavInfo info;
+    info.channels = PassEngine::outputChannels(channels);
+    info.sample_rate = sample_rate;
+    info.format = format;
+    info.frames = frames;
+    return info;
+  }
+};
+
+/**
+ * The files of a pipelined render. Readers and writer set up their buffers
+ * and io_uring on first use and keep them when they reopen, so the files of
+ * a batch share them rather than paying for them each.
+ */
+struct RenderStreams {
+  RenderInputs in;
+  WavWriter writer;
+};
+
+/**
+ * Runs reading/decoding, DSP and encoding/writing on three threads linked by
+ * queues of recycled blocks, so disk and CPU work overlap.
+ */
+static bool renderPipelined(const RenderOptions& options,
+                            RenderStreams* streams, std::string* error) {
+  RenderInputs& in = streams->in;
+  if (!in.open(options, error)) return false;
+
+  WavInfo out_info = in.outputInfo(options.format);
+  WavWriter& writer = streams->writer;
+  PcmDither dither;
+  dither.enabled = options.dither;
+  writer.dither = &dither;
+  if (!writer.open(options.output, out_info, error)) return false;
+
+  int block_frames = options.block_frames;
+  std::vector<RenderBlock> blocks(POOL_BLOCKS);
+  SpscQueue<RenderBlock*> free_blocks(POOL_BLOCKS);
+  SpscQueue<RenderBlock*> read_blocks(POOL_BLOCKS);
+  SpscQueue<RenderBlock*> done_blocks(POOL_BLOCKS);
+  for (RenderBlock& block : blocks) {
+    in.allocate(&block, out_info.channels, block_frames);
+    free_blocks.push(&block);
+  }
+
+  // A failed read ends the stream early; the render fails after the join.
+  std::string read_error;
+  std::thread reader([&]() {
+    int64_t position = 0;
+    while (true) {
+      RenderBlock* block = free_blocks.pop();
+      block->frames =
+          (int)std::min<int64_t>(block_frames, in.frames - position);
+      if (!in.read(block, block_frames, &read_error)) {
+        block->frames = 0;
+      }
+      position += block->frames;
+      read_blocks.push(block);
+      if (block->frames == 0) break;
+    }
+  });
+
+  PassEngine engine;
+  engine.average = options.average;
+  std::thread dsp([&]() {
+    while (true) {
+      RenderBlock* block = read_blocks.pop();
+      if (block->frames > 0) {
+        in.process(engine, block, block_frames);
+      }
+      done_blocks.push(block);
+      if (block->frames == 0) break;
+    }
+  });
+
+  Analyzer analyzer;
+  bool analyze = !options.report.empty();
+  if (analyze) {
+    analyzer.init(out_info.channels, out_info.sample_rate);
+  }
+
+  // A failed write keeps draining the pipeline so the other stages finish.
+  bool written = true;
+  while (true) {
+    RenderBlock* block = done_blocks.pop();
+    if (block->frames == 0) break;
+    written = written && writer.write(block->output.data(), block_frames,
+                                      block->frames);
+    if (analyze) {
+      analyzer.process(block->output.data(), block_frames, block->frames);
+    }
+    free_blocks.push(block);
+  }
+
+  reader.join();
+  dsp.join();
+
+  if (!read_error.empty()) {
+    writer.close();
+    *error = read_error;
+    return false;
+  }
+  if (!writer.close() || !written) {
+    *error = "cannot write " + options.output;
+    return false;
+  }
+  if (analyze) {
+    analyzer.finish();
+    if (!analyzer.writeReport(options.report, options.output, out_info)) {
+      *error = "cannot write " + options.report;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Splits the file into segments rendered concurrently, each worker with its
+ * own readers, engine copy and output handle. A segment starts rendering
+ * warmupFrames() early and discards that pre-roll, so stateful stages settle
+ * before its first written frame; stateless SUM/AVG output is bit-identical
+ * to a serial render.
+ */
+static bool renderParallel(const RenderOptions& options, std::string* error) {
+  RenderInputs probe;
+  if (!probe.open(options, error)) return false;
+
+  WavInfo out_info = probe.outputInfo(options.format);
+  WavWriter header;
+  if (!header.create(options.output, out_info, error)) return false;
+
+  PassEngine prototype;
+  prototype.average = options.average;
+  int64_t preroll = prototype.warmupFrames();
+  int block_frames = options.block_frames;
+  // Several segments per worker even out the load across threads.
+  int64_t segments = (int64_t)options.jobs * 4;
+  int64_t segment_frames = std::max<int64_t>(
+      block_frames, (out_info.frames + segments - 1) / segments);
+
+  // Each worker analyzes the segments it renders. Segments start on gating
+  // hop boundaries so that the merged blocks are exactly the serial ones.
+  bool analyze = !options.report.empty();
+  Analyzer analyzer;
+  if (analyze) {
+    analyzer.init(out_info.channels, out_info.sample_rate);
+    int64_t hop = analyzer.hopFrames();
+    preroll = std::max<int64_t>(preroll, analyzer.warmupFrames());
+    segment_frames = (segment_frames + hop - 1) / hop * hop;
+  }
+  std::vector<Analyzer> analyzers(options.jobs, analyzer);
+
+  std::atomic<int64_t> next_segment{0};
+  std::atomic<bool> failed{false};
+  std::vector<std::string> errors(options.jobs);
+  std::vector<std::thread> workers;
+  for (int j = 0; j < options.jobs; ++j) {
+    workers.emplace_back([&, j]() {
+      RenderInputs in;
+      WavWriter writer;
+      // The dither of each sample follows from its position in the file,
+      // which writer.seek() sets, so the output matches a serial render.
+      PcmDither dither;
+      dither.enabled = options.dither;
+      writer.dither = &dither;
+      std::string& worker_error = errors[j];
+      if (!in.open(options, &worker_error) ||
+          !writer.openForUpdate(options.output, out_info, &worker_error)) {
+        failed = true;
+        return;
+      }
+      PassEngine engine = prototype;
+      Analyzer& segment_analyzer = analyzers[j];
+      RenderBlock block;
+      in.allocate(&block, out_info.channels, block_frames);
+
+      while (!failed) {
+        int64_t start = next_segment++ * segment_frames;
+        if (start >= out_info.frames) break;
+        int64_t end = std::min(start + segment_frames, out_info.frames);
+        int64_t position = std::max<int64_t>(0, start - preroll);
+        if (!in.seek(position) || !writer.seek(start)) {
+          failed = true;
+          break;
+        }
+        if (analyze) {
+          segment_analyzer.seek(position, start);
+        }
+
+        while (position < end) {
+          block.frames = (int)std::min<int64_t>(block_frames, end - position);
+          if (!in.read(&block, block_frames, &worker_error)) {
+            failed = true;
+            break;
+          }
+          in.process(engine, &block, block_frames);
+          int skip = (int)std::min<int64_t>(
+              block.frames, std::max<int64_t>(0, start - position));
+          if (block.frames > skip &&
+              !writer.write(block.output.data() + skip, block_frames,
+                            block.frames - skip)) {
+            failed = true;
+            break;
+          }
+          if (analyze) {
+            segment_analyzer.process(block.output.data(), block_frames,
+                                     block.frames);
+          }
+          position += block.frames;
+        }
+        if (analyze && end == out_info.frames) {
+          segment_analyzer.finish();
+        }
+      }
+      if (!writer.close()) failed = true;
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  if (failed) {
+    *error = "cannot render " + options.output;
+    for (const std::string& worker_error : errors) {
+      if (!worker_error.empty()) {
+        *error = worker_error;
+        break;
+      }
+    }
+    return false;
+  }
+  if (analyze) {
+    for (const Analyzer& segment_analyzer : analyzers) {
+      analyzer.merge(segment_analyzer);
+    }
+    if (!analyzer.writeReport(options.report, options.output, out_info)) {
+      *error = "cannot write " + options.report;
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Renders the lines of options.batch in order, reusing the streams. A file
+ * that fails is reported and the batch carries on with the next one.
+ */
+static bool renderBatch(const RenderOptions& options) {
+  std::ifstream list(options.batch);
+  if (!list) {
+    std::fprintf(stderr, "pass_render: cannot open %s\n",
+                 options.batch.c_str());
+    return false;
+  }
+
+  RenderStreams streams;
+  bool ok = true;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(list, line)) {
+    ++line_number;
+    std::istringstream fields(line);
+    std::vector<std::string> paths;
+    std::string path;
+    while (fields >> path) {
+      paths.push_back(path);
+    }
+    if (paths.empty() || paths[0][0] == '#') continue;
+
+    std::string error;
+    if (paths.size() < 2 || paths.size() > 1 + PassEngine::MAX_INPUTS) {
+      error = "expected OUT.wav and 1 to 3 inputs";
+    } else {
+      RenderOptions file_options = options;
+      file_options.output = paths[0];
+      for (size_t i = 1; i < paths.size(); ++i) {
+        file_options.inputs[file_options.num_inputs++] = paths[i];
+      }
+      if (renderPipelined(file_options, &streams, &error)) continue;
+    }
+    std::fprintf(stderr, "pass_render: %s:%d: %s\n", options.batch.c_str(),
+                 line_number, error.c_str());
+    ok = false;
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  RenderOptions options;
+  if (!parseOptions(argc, argv, &options)) {
+    printUsage();
+    return 2;
+  }
+  if (!options.batch.empty()) {
+    return renderBatch(options) ? 0 : 1;
+  }
+
+  std::string error;
+  bool rendered;
+  if (options.jobs > 1) {
+    rendered = renderParallel(options, &error);
+  } else {
+    RenderStreams streams;
+    rendered = renderPipelined(options, &streams, &error);
+  }
+  if (!rendered) {
+    std::fprintf(stderr, "pass_render: %s\n", error.c_str());
+    return 1;
+  }
+  return 0;
+}